@@ -0,0 +1,84 @@
+#include "ntff_arena.h"
+#include <cstdlib>
+#include <cstdint>
+#include <functional>
+
+namespace Ntff {
+
+static const size_t blockSize = 64 * 1024;
+static const size_t initialStrings = 1024;
+
+Arena::Arena(): pos(nullptr), end(nullptr), used(0), reserved(0), stringsNum(0) {}
+
+Arena::~Arena()
+{
+	for (char *block: blocks) { free(block); }
+}
+
+void *Arena::alloc(size_t size, size_t align)
+{
+	uintptr_t aligned = ((uintptr_t)pos + align - 1) & ~(uintptr_t)(align - 1);
+	if (pos && aligned + size <= (uintptr_t)end)
+	{
+		used += aligned + size - (uintptr_t)pos;
+		pos = (char *)aligned + size;
+		return (void *)aligned;
+	}
+
+	//big allocations get own block, so the current one is still filled
+	bool own = size + align > blockSize / 4;
+	size_t allocSize = own ? size + align : blockSize;
+	char *block = (char *)malloc(allocSize);
+	if (!block) { throw std::bad_alloc(); }
+	reserved += allocSize;
+	used += size;
+	aligned = ((uintptr_t)block + align - 1) & ~(uintptr_t)(align - 1);
+
+	if (own)
+	{
+		blocks.insert(blocks.begin(), block);
+		return (void *)aligned;
+	}
+	blocks.push_back(block);
+	pos = (char *)aligned + size;
+	end = block + allocSize;
+	return (void *)aligned;
+}
+
+const char *Arena::intern(const char *str, size_t len)
+{
+	if (stringsNum * 10 >= strings.size() * 7) { growStrings(); }
+
+	size_t hash = std::hash<std::string_view>()(std::string_view(str, len));
+	size_t mask = strings.size() - 1;
+	size_t id = hash & mask;
+	for (; strings[id].str; id = (id + 1) & mask)
+	{
+		const Slot &slot = strings[id];
+		if (slot.hash == hash && slot.len == len && memcmp(slot.str, str, len) == 0) { return slot.str; }
+	}
+
+	char *res = (char *)alloc(len + 1, 1);
+	memcpy(res, str, len);
+	res[len] = 0;
+	strings[id] = Slot{res, len, hash};
+	stringsNum++;
+	return res;
+}
+
+void Arena::growStrings()
+{
+	std::vector<Slot> old;
+	old.swap(strings);
+	strings.resize(old.empty() ? initialStrings : old.size() * 2, Slot{nullptr, 0, 0});
+	size_t mask = strings.size() - 1;
+	for (const Slot &slot: old)
+	{
+		if (!slot.str) { continue; }
+		size_t id = slot.hash & mask;
+		while (strings[id].str) { id = (id + 1) & mask; }
+		strings[id] = slot;
+	}
+}
+
+}
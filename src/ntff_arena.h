@@ -0,0 +1,85 @@
+#ifndef NTFF_ARENA_H
+#define NTFF_ARENA_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <utility>
+#include <type_traits>
+#include <string_view>
+
+namespace Ntff {
+
+//array placed in arena, not owning
+template<class T>
+class ArenaArray
+{
+public:
+	ArenaArray(): items(nullptr), num(0) {}
+	ArenaArray(T *items, size_t num): items(items), num(num) {}
+	T *begin() const { return items; }
+	T *end() const { return items + num; }
+	size_t size() const { return num; }
+	bool empty() const { return num == 0; }
+	T &operator[](size_t id) const { return items[id]; }
+private:
+	T *items;
+	size_t num;
+};
+
+/* Bump-pointer allocator owning the parsed project model, freed at once.
+ * Objects are never destroyed one by one, so they must be trivially destructible:
+ * strings are interned (one copy of every id or path), lists are ArenaArrays. */
+class Arena
+{
+public:
+	Arena();
+	~Arena();
+	Arena(const Arena &) = delete;
+	Arena &operator=(const Arena &) = delete;
+
+	void *alloc(size_t size, size_t align);
+	template<class T, class... Args> T *create(Args&&... args)
+	{
+		static_assert(std::is_trivially_destructible<T>::value, "arena objects are not destroyed");
+		return new (alloc(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+	}
+	template<class T> ArenaArray<T> copy(const std::vector<T> &items)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "arena arrays are copied as memory");
+		if (items.empty()) { return ArenaArray<T>(); }
+		T *res = (T *)alloc(sizeof(T) * items.size(), alignof(T));
+		memcpy((void *)res, items.data(), sizeof(T) * items.size());
+		return ArenaArray<T>(res, items.size());
+	}
+	const char *intern(const char *str, size_t len);
+	const char *intern(const char *str) { return intern(str, strlen(str)); }
+	const char *intern(const std::string &str) { return intern(str.data(), str.size()); }
+	const char *intern(std::string_view str) { return intern(str.data(), str.size()); }
+
+	size_t getUsed() const { return used; } //bytes given out, with padding
+	size_t getReserved() const { return reserved; }
+private:
+	struct Slot
+	{
+		const char *str;
+		size_t len;
+		size_t hash;
+	};
+
+	std::vector<char *> blocks;
+	char *pos;
+	char *end;
+	size_t used;
+	size_t reserved;
+	std::vector<Slot> strings; //open addressing, power of two size
+	size_t stringsNum;
+
+	void growStrings();
+};
+
+}
+
+#endif // NTFF_ARENA_H
@@ -0,0 +1,375 @@
+#include "ntff_bitmap.h"
+#include <algorithm>
+
+namespace Ntff {
+
+static uint32_t nextSet(const uint64_t *words, size_t wordsNum, uint32_t pos)
+{
+	size_t w = pos / 64;
+	if (w >= wordsNum) { return wordsNum * 64; }
+	uint64_t bits = words[w] & (~0ULL << (pos % 64));
+	while (!bits)
+	{
+		if (++w == wordsNum) { return wordsNum * 64; }
+		bits = words[w];
+	}
+	return w * 64 + __builtin_ctzll(bits);
+}
+
+static uint32_t nextClear(const uint64_t *words, size_t wordsNum, uint32_t pos)
+{
+	size_t w = pos / 64;
+	if (w >= wordsNum) { return wordsNum * 64; }
+	uint64_t bits = ~words[w] & (~0ULL << (pos % 64));
+	while (!bits)
+	{
+		if (++w == wordsNum) { return wordsNum * 64; }
+		bits = ~words[w];
+	}
+	return w * 64 + __builtin_ctzll(bits);
+}
+
+bool FrameBitmap::Chunk::contains(uint16_t low) const
+{
+	switch (type)
+	{
+		case Array: return std::binary_search(array.begin(), array.end(), low);
+		case Words: return words[low / 64] & (1ULL << (low % 64));
+		default:
+		{
+			auto it = std::upper_bound(runs.begin(), runs.end(), low,
+				[](uint16_t value, const Run &run) { return value < run.start; });
+			return it != runs.begin() && (--it)->last >= low;
+		}
+	}
+}
+
+void FrameBitmap::Chunk::toWords(uint64_t *res) const
+{
+	if (type == Words) { std::copy(words.begin(), words.end(), res); return; }
+	std::fill(res, res + wordsNum, 0);
+	if (type == Array)
+	{
+		for (uint16_t low: array) { res[low / 64] |= 1ULL << (low % 64); }
+	}
+	else
+	{
+		for (const Run &run: runs) { setRange(res, run.start, (uint32_t)run.last + 1); }
+	}
+}
+
+template<class F> void FrameBitmap::Chunk::forEachRun(F f) const
+{
+	if (type == Runs)
+	{
+		for (const Run &run: runs) { f(run.start, (uint32_t)run.last + 1); }
+	}
+	else if (type == Array)
+	{
+		for (size_t i = 0; i < array.size();)
+		{
+			size_t first = i++;
+			while (i < array.size() && array[i] == array[i - 1] + 1) { i++; }
+			f(array[first], (uint32_t)array[i - 1] + 1);
+		}
+	}
+	else
+	{
+		for (uint32_t start = nextSet(words.data(), wordsNum, 0); start < chunkSize;)
+		{
+			uint32_t end = nextClear(words.data(), wordsNum, start);
+			f(start, end);
+			start = nextSet(words.data(), wordsNum, end);
+		}
+	}
+}
+
+void FrameBitmap::setRange(uint64_t *words, uint32_t start, uint32_t end)
+{
+	if (start >= end) { return; }
+	size_t first = start / 64, last = (end - 1) / 64;
+	uint64_t firstMask = ~0ULL << (start % 64);
+	uint64_t lastMask = ~0ULL >> (63 - (end - 1) % 64);
+	if (first == last) { words[first] |= firstMask & lastMask; return; }
+	words[first] |= firstMask;
+	for (size_t w = first + 1; w < last; w++) { words[w] = ~0ULL; }
+	words[last] |= lastMask;
+}
+
+//representation is chosen by size: 4 bytes a run, 2 bytes a frame or 8 KB of words
+FrameBitmap::Chunk FrameBitmap::fromRuns(uint64_t key, std::vector<Run> &runs)
+{
+	Chunk res;
+	res.key = key;
+	res.cardinality = 0;
+	for (const Run &run: runs) { res.cardinality += run.last - run.start + 1; }
+	size_t runsBytes = runs.size() * sizeof(Run);
+	size_t arrayBytes = res.cardinality * sizeof(uint16_t);
+	if (runsBytes <= arrayBytes && runsBytes <= wordsNum * sizeof(uint64_t))
+	{
+		res.type = Chunk::Runs;
+		res.runs.swap(runs);
+	}
+	else if (arrayBytes <= wordsNum * sizeof(uint64_t))
+	{
+		res.type = Chunk::Array;
+		res.array.reserve(res.cardinality);
+		for (const Run &run: runs)
+		{
+			for (uint32_t low = run.start; low <= run.last; low++) { res.array.push_back(low); }
+		}
+	}
+	else
+	{
+		res.type = Chunk::Words;
+		res.words.assign(wordsNum, 0);
+		for (const Run &run: runs) { setRange(res.words.data(), run.start, (uint32_t)run.last + 1); }
+	}
+	return res;
+}
+
+FrameBitmap::Chunk FrameBitmap::fromWords(uint64_t key, const uint64_t *words)
+{
+	uint32_t cardinality = 0, runsNum = 0;
+	uint64_t carry = 0;
+	for (size_t w = 0; w < wordsNum; w++)
+	{
+		cardinality += __builtin_popcountll(words[w]);
+		runsNum += __builtin_popcountll(words[w] & ~((words[w] << 1) | carry)); //first frames of runs
+		carry = words[w] >> 63;
+	}
+	Chunk res;
+	res.key = key;
+	res.cardinality = cardinality;
+	size_t runsBytes = runsNum * sizeof(Run);
+	size_t arrayBytes = cardinality * sizeof(uint16_t);
+	if (runsBytes <= arrayBytes && runsBytes <= wordsNum * sizeof(uint64_t))
+	{
+		res.type = Chunk::Runs;
+		res.runs.reserve(runsNum);
+		for (uint32_t start = nextSet(words, wordsNum, 0); start < chunkSize;)
+		{
+			uint32_t end = nextClear(words, wordsNum, start);
+			res.runs.push_back({(uint16_t)start, (uint16_t)(end - 1)});
+			start = nextSet(words, wordsNum, end);
+		}
+	}
+	else if (arrayBytes <= wordsNum * sizeof(uint64_t))
+	{
+		res.type = Chunk::Array;
+		res.array.reserve(cardinality);
+		for (size_t w = 0; w < wordsNum; w++)
+		{
+			for (uint64_t bits = words[w]; bits; bits &= bits - 1)
+			{
+				res.array.push_back(w * 64 + __builtin_ctzll(bits));
+			}
+		}
+	}
+	else
+	{
+		res.type = Chunk::Words;
+		res.words.assign(words, words + wordsNum);
+	}
+	return res;
+}
+
+//union or difference, word loop has no branch on it
+template<bool add> FrameBitmap::Chunk FrameBitmap::modify(const Chunk &a, const Chunk &b)
+{
+	if (a.type == Chunk::Runs && b.type == Chunk::Runs)
+	{
+		//both are a few runs, merged the same way IntervalSet does
+		IntervalSet res, other;
+		for (const Run &run: a.runs) { res.append(run.start, (frame_id)run.last + 1); }
+		for (const Run &run: b.runs) { other.append(run.start, (frame_id)run.last + 1); }
+		if (add) { res.unite(other); }
+		else { res.subtract(other); }
+		std::vector<Run> runs(res.size());
+		for (size_t i = 0; i < res.size(); i++) { runs[i] = {(uint16_t)res.getIn(i), (uint16_t)(res.getOut(i) - 1)}; }
+		return fromRuns(a.key, runs);
+	}
+
+	uint64_t wa[wordsNum], wb[wordsNum];
+	a.toWords(wa);
+	b.toWords(wb);
+	if (add)
+	{
+		for (size_t w = 0; w < wordsNum; w++) { wa[w] |= wb[w]; }
+	}
+	else
+	{
+		for (size_t w = 0; w < wordsNum; w++) { wa[w] &= ~wb[w]; }
+	}
+	return fromWords(a.key, wa);
+}
+
+FrameBitmap FrameBitmap::fromSet(const IntervalSet &set)
+{
+	FrameBitmap res;
+	std::vector<Run> runs;
+	uint64_t key = 0;
+	for (size_t i = 0; i < set.size(); i++)
+	{
+		for (frame_id in = set.getIn(i), out = set.getOut(i); in < out;)
+		{
+			uint64_t inKey = in >> chunkBits;
+			if (inKey != key && !runs.empty()) { res.chunks.push_back(fromRuns(key, runs)); runs.clear(); }
+			key = inKey;
+			frame_id chunkEnd = (frame_id)(key + 1) << chunkBits;
+			frame_id end = std::min(out, chunkEnd);
+			runs.push_back({(uint16_t)(in & (chunkSize - 1)), (uint16_t)((end - 1) & (chunkSize - 1))});
+			in = end;
+		}
+	}
+	if (!runs.empty()) { res.chunks.push_back(fromRuns(key, runs)); }
+	return res;
+}
+
+//intervals are set right into words of the chunk, without merging them first
+FrameBitmap FrameBitmap::fromIntervals(const std::vector<Interval> &intervals, int8_t min, int8_t max)
+{
+	FrameBitmap res;
+	uint64_t words[wordsNum];
+	uint64_t key = 0;
+	bool opened = false;
+	frame_id maxOut = 0; //intervals may go on into next chunks
+	auto open = [&](uint64_t newKey)
+	{
+		key = newKey;
+		opened = true;
+		std::fill(words, words + wordsNum, 0);
+		frame_id base = (frame_id)key << chunkBits;
+		if (maxOut > base) { setRange(words, 0, std::min<frame_id>(maxOut - base, chunkSize)); }
+	};
+	auto close = [&]()
+	{
+		Chunk chunk = fromWords(key, words);
+		if (chunk.cardinality) { res.chunks.push_back(std::move(chunk)); }
+	};
+	auto closeUpTo = [&](uint64_t nextKey) //with chunks covered by the previous intervals only
+	{
+		close();
+		for (uint64_t k = key + 1; k < nextKey && maxOut > ((frame_id)k << chunkBits); k++) { open(k); close(); }
+	};
+
+	for (const Interval &interval: intervals)
+	{
+		if (interval.intensity < min || interval.intensity > max || interval.in >= interval.out) { continue; }
+		uint64_t inKey = interval.in >> chunkBits;
+		if (!opened || inKey != key)
+		{
+			if (opened) { closeUpTo(inKey); }
+			open(inKey);
+		}
+		frame_id base = (frame_id)key << chunkBits;
+		setRange(words, interval.in - base, std::min<frame_id>(interval.out - base, chunkSize));
+		maxOut = std::max(maxOut, interval.out);
+	}
+	if (opened) { closeUpTo(UINT64_MAX); }
+	return res;
+}
+
+IntervalSet FrameBitmap::toSet() const
+{
+	IntervalSet res;
+	for (const Chunk &chunk: chunks)
+	{
+		frame_id base = (frame_id)chunk.key << chunkBits;
+		chunk.forEachRun([&res, base](uint32_t start, uint32_t end) { res.append(base + start, base + end); });
+	}
+	return res;
+}
+
+bool FrameBitmap::contains(frame_id frame) const
+{
+	if (frame < 0) { return false; }
+	uint64_t key = frame >> chunkBits;
+	auto it = std::lower_bound(chunks.begin(), chunks.end(), key,
+		[](const Chunk &chunk, uint64_t key) { return chunk.key < key; });
+	return it != chunks.end() && it->key == key && it->contains(frame & (chunkSize - 1));
+}
+
+frame_id FrameBitmap::length() const
+{
+	frame_id res = 0;
+	for (const Chunk &chunk: chunks) { res += chunk.cardinality; }
+	return res;
+}
+
+size_t FrameBitmap::getBytes() const
+{
+	size_t res = chunks.capacity() * sizeof(Chunk);
+	for (const Chunk &chunk: chunks)
+	{
+		res += chunk.array.capacity() * sizeof(uint16_t) + chunk.words.capacity() * sizeof(uint64_t) +
+			chunk.runs.capacity() * sizeof(Run);
+	}
+	return res;
+}
+
+void FrameBitmap::unite(const FrameBitmap &other)
+{
+	std::vector<Chunk> res;
+	res.reserve(chunks.size() + other.chunks.size());
+	size_t i = 0, j = 0;
+	while (i < chunks.size() || j < other.chunks.size())
+	{
+		if (j == other.chunks.size() || (i < chunks.size() && chunks[i].key < other.chunks[j].key))
+		{
+			res.push_back(std::move(chunks[i++]));
+		}
+		else if (i == chunks.size() || other.chunks[j].key < chunks[i].key) { res.push_back(other.chunks[j++]); }
+		else { res.push_back(modify<true>(chunks[i++], other.chunks[j++])); }
+	}
+	chunks.swap(res);
+}
+
+void FrameBitmap::subtract(const FrameBitmap &other)
+{
+	std::vector<Chunk> res;
+	res.reserve(chunks.size());
+	size_t j = 0;
+	for (Chunk &chunk: chunks)
+	{
+		while (j < other.chunks.size() && other.chunks[j].key < chunk.key) { j++; }
+		if (j == other.chunks.size() || other.chunks[j].key != chunk.key) { res.push_back(std::move(chunk)); }
+		else
+		{
+			Chunk left = modify<false>(chunk, other.chunks[j]);
+			if (left.cardinality) { res.push_back(std::move(left)); }
+		}
+	}
+	chunks.swap(res);
+}
+
+FrameBitmap FrameBitmap::complement(frame_id wholeDuration) const
+{
+	FrameBitmap res;
+	if (wholeDuration <= 0) { return res; }
+	uint64_t lastKey = (wholeDuration - 1) >> chunkBits;
+	size_t i = 0;
+	for (uint64_t key = 0; key <= lastKey; key++)
+	{
+		uint32_t limit = std::min<frame_id>(chunkSize, wholeDuration - ((frame_id)key << chunkBits));
+		if (i == chunks.size() || chunks[i].key != key)
+		{
+			std::vector<Run> runs = {{0, (uint16_t)(limit - 1)}};
+			res.chunks.push_back(fromRuns(key, runs));
+			continue;
+		}
+		uint64_t words[wordsNum];
+		chunks[i++].toWords(words);
+		for (size_t w = 0; w < wordsNum; w++) { words[w] = ~words[w]; }
+		if (limit < chunkSize)
+		{
+			std::fill(words + (limit + 63) / 64, words + wordsNum, 0);
+			if (limit % 64) { words[limit / 64] &= ~0ULL >> (64 - limit % 64); }
+		}
+		Chunk chunk = fromWords(key, words);
+		if (chunk.cardinality) { res.chunks.push_back(std::move(chunk)); }
+	}
+	return res;
+}
+
+}
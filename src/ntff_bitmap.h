@@ -0,0 +1,64 @@
+#ifndef NTFF_BITMAP_H
+#define NTFF_BITMAP_H
+
+#include <vector>
+#include <cstdint>
+#include "ntff_feature.h"
+#include "ntff_intervals.h"
+
+namespace Ntff {
+
+/* Set of frames, roaring-style: frames are split into chunks of 65536, every chunk
+ * keeps its frames as sorted array, bitmap or runs, whichever is smaller. Union and
+ * difference of chunks go word by word (64 frames at once), so for dense features
+ * (many intervals of a few frames) a rule costs the same whatever the intervals are.
+ * Converted back to IntervalSet for playback, which seeks and plans by intervals. */
+class FrameBitmap
+{
+public:
+	static FrameBitmap fromSet(const IntervalSet &set);
+	static FrameBitmap fromIntervals(const std::vector<Interval> &intervals, int8_t min, int8_t max);
+	IntervalSet toSet() const;
+
+	bool empty() const { return chunks.empty(); }
+	bool contains(frame_id frame) const;
+	frame_id length() const; //frames in the set
+	size_t getBytes() const; //taken by containers
+	void unite(const FrameBitmap &other);
+	void subtract(const FrameBitmap &other);
+	FrameBitmap complement(frame_id wholeDuration) const; //within [0, wholeDuration)
+private:
+	static const int chunkBits = 16;
+	static const uint32_t chunkSize = 1 << chunkBits;
+	static const size_t wordsNum = chunkSize / 64;
+
+	struct Run
+	{
+		uint16_t start;
+		uint16_t last; //inclusive, so the whole chunk is one run
+	};
+	struct Chunk
+	{
+		enum Type: uint8_t {Array, Words, Runs};
+		uint64_t key; //frame >> chunkBits
+		Type type;
+		uint32_t cardinality;
+		std::vector<uint16_t> array;
+		std::vector<uint64_t> words;
+		std::vector<Run> runs;
+
+		bool contains(uint16_t low) const;
+		void toWords(uint64_t *res) const;
+		template<class F> void forEachRun(F f) const; //f(start, end), end exclusive
+	};
+	std::vector<Chunk> chunks; //sorted by key
+
+	static Chunk fromWords(uint64_t key, const uint64_t *words);
+	static Chunk fromRuns(uint64_t key, std::vector<Run> &runs);
+	template<bool add> static Chunk modify(const Chunk &a, const Chunk &b);
+	static void setRange(uint64_t *words, uint32_t start, uint32_t end);
+};
+
+}
+
+#endif // NTFF_BITMAP_H
@@ -0,0 +1,218 @@
+#include "ntff_cache.h"
+#include "ntff_mmap.h"
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <filesystem>
+
+namespace Ntff {
+
+static const char cacheMagic[4] = {'N', 'T', 'F', 'C'};
+static const uint32_t cacheVersion = 2;
+
+ProjectCache::ProjectCache(const std::string &projectFile):
+	file(nullptr), valid(false), header(nullptr),
+	entries(nullptr), features(nullptr), intervals(nullptr), strings(nullptr)
+{
+	file = new MappedFile(pathFor(projectFile));
+	valid = file->isValid() && validate(projectFile);
+}
+
+ProjectCache::~ProjectCache()
+{
+	delete file;
+}
+
+std::string ProjectCache::pathFor(const std::string &projectFile)
+{
+	return std::filesystem::path(projectFile).replace_extension(".ntffc");
+}
+
+bool ProjectCache::validate(const std::string &projectFile)
+{
+	const uint8_t *data = file->getData();
+	size_t size = file->getSize();
+	if (size < sizeof(Header)) { return false; }
+
+	header = (const Header *)data;
+	if (memcmp(header->magic, cacheMagic, sizeof(cacheMagic)) != 0) { return false; }
+	if (header->version != cacheVersion) { return false; }
+	if (!getFrameRate().isValid()) { return false; }
+
+	uint64_t expectedSize = sizeof(Header) +
+		header->entriesNum * sizeof(CachedEntry) +
+		header->featuresNum * sizeof(CachedFeature);
+	if (header->intervalsNum > size / sizeof(CachedInterval) || header->stringsSize > size) { return false; }
+	expectedSize += header->intervalsNum * sizeof(CachedInterval) + header->stringsSize;
+	if (expectedSize != size) { return false; }
+
+	if (MappedFile::hash(data + sizeof(Header), size - sizeof(Header)) != header->bodyHash)
+	{
+		return false;
+	}
+
+	MappedFile source(projectFile);
+	if (!source.isValid() ||
+		source.getSize() != header->sourceSize ||
+		source.getMtime() != header->sourceMtime ||
+		MappedFile::hash(source.getData(), source.getSize()) != header->sourceHash)
+	{
+		return false;
+	}
+
+	entries = (const CachedEntry *)(data + sizeof(Header));
+	features = (const CachedFeature *)(entries + header->entriesNum);
+	intervals = (const CachedInterval *)(features + header->featuresNum);
+	strings = (const char *)(intervals + header->intervalsNum);
+
+	//every string offset must point inside of null-terminated string table
+	if (header->stringsSize == 0 || strings[header->stringsSize - 1] != '\0') { return false; }
+	for (size_t i = 0; i < header->entriesNum; i++)
+	{
+		if (entries[i].resource >= header->stringsSize) { return false; }
+	}
+	for (size_t i = 0; i < header->featuresNum; i++)
+	{
+		const CachedFeature &f = features[i];
+		if (f.name >= header->stringsSize || f.description >= header->stringsSize ||
+			f.action >= header->stringsSize || f.eq >= header->stringsSize)
+		{
+			return false;
+		}
+		if (f.firstInterval > header->intervalsNum ||
+			f.intervalsNum > header->intervalsNum - f.firstInterval)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+FrameRate ProjectCache::getFrameRate() const
+{
+	return FrameRate(header->frameRateNum, header->frameRateDen);
+}
+
+size_t ProjectCache::getEntriesNum() const
+{
+	return header->entriesNum;
+}
+
+Interval ProjectCache::getEntryInterval(size_t id) const
+{
+	const CachedInterval &interval = entries[id].interval;
+	return Interval(interval.in, interval.out, interval.intensity);
+}
+
+const char *ProjectCache::getEntryResource(size_t id) const
+{
+	return getString(entries[id].resource);
+}
+
+FeatureList *ProjectCache::createFeatureList() const
+{
+	FeatureList *flist = new FeatureList();
+	for (size_t i = 0; i < header->featuresNum; i++)
+	{
+		const CachedFeature &f = features[i];
+		Feature *feature = new Feature(getString(f.name), getString(f.description),
+			getString(f.action), getString(f.eq), f.recIntensity);
+
+		const CachedInterval *interval = intervals + f.firstInterval;
+		for (uint64_t id = 0; id < f.intervalsNum; id++, interval++)
+		{
+			feature->appendInterval(Interval(interval->in, interval->out, interval->intensity));
+		}
+		flist->push_back(feature);
+	}
+	return flist;
+}
+
+uint64_t ProjectCache::Writer::addString(const std::string &str)
+{
+	auto it = stringIndex.find(str);
+	if (it != stringIndex.end()) { return it->second; }
+
+	uint64_t offset = strings.size();
+	strings.append(str.c_str(), str.size() + 1);
+	stringIndex.emplace(str, offset);
+	return offset;
+}
+
+void ProjectCache::Writer::addEntry(const Interval &interval, const std::string &resource)
+{
+	CachedEntry entry = {};
+	entry.interval.in = interval.in;
+	entry.interval.out = interval.out;
+	entry.interval.intensity = interval.intensity;
+	entry.resource = addString(resource);
+	entries.push_back(entry);
+}
+
+void ProjectCache::Writer::addFeature(const Feature &feature)
+{
+	CachedFeature cached = {};
+	cached.name = addString(feature.getName());
+	cached.description = addString(feature.getDescription());
+	cached.action = addString(feature.getAction());
+	cached.eq = addString(feature.getEq());
+	cached.recIntensity = feature.getRecIntensity();
+	cached.firstInterval = intervals.size();
+	features.push_back(cached);
+}
+
+void ProjectCache::Writer::addFeatureInterval(const Interval &interval)
+{
+	CachedInterval cached = {};
+	cached.in = interval.in;
+	cached.out = interval.out;
+	cached.intensity = interval.intensity;
+	intervals.push_back(cached);
+	features.back().intervalsNum++;
+}
+
+bool ProjectCache::Writer::write(const std::string &projectFile) const
+{
+	MappedFile source(projectFile);
+	if (!source.isValid()) { return false; }
+
+	std::string body;
+	body.append((const char *)entries.data(), entries.size() * sizeof(CachedEntry));
+	body.append((const char *)features.data(), features.size() * sizeof(CachedFeature));
+	body.append((const char *)intervals.data(), intervals.size() * sizeof(CachedInterval));
+	body.append(strings.empty() ? std::string(1, '\0') : strings);
+
+	Header header = {};
+	memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+	header.version = cacheVersion;
+	header.sourceSize = source.getSize();
+	header.sourceMtime = source.getMtime();
+	header.sourceHash = MappedFile::hash(source.getData(), source.getSize());
+	header.bodyHash = MappedFile::hash((const uint8_t *)body.data(), body.size());
+	header.frameRateNum = frameRate.num;
+	header.frameRateDen = frameRate.den;
+	header.entriesNum = entries.size();
+	header.featuresNum = features.size();
+	header.intervalsNum = intervals.size();
+	header.stringsSize = strings.empty() ? 1 : strings.size();
+
+	//write to temporary file first, so concurrent readers never see partial cache
+	std::string path = pathFor(projectFile);
+	std::string tmpPath = path + ".tmp";
+	{
+		std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+		if (!out) { return false; }
+		out.write((const char *)&header, sizeof(header));
+		out.write(body.data(), body.size());
+		if (!out) { out.close(); remove(tmpPath.c_str()); return false; }
+	}
+	if (rename(tmpPath.c_str(), path.c_str()) != 0)
+	{
+		remove(tmpPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+}
@@ -0,0 +1,106 @@
+#ifndef NTFF_CACHE_H
+#define NTFF_CACHE_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "ntff_feature.h"
+#include "ntff_timecode.h"
+
+namespace Ntff {
+
+class MappedFile;
+
+/* Compiled snapshot of a resolved project (.ntffc file next to the project).
+ * It keeps the main playlist entries with resolved resource paths and every
+ * feature with its intervals, so a reopen does not need to parse the XML.
+ * The snapshot is keyed by size, mtime and content hash of the project file. */
+class ProjectCache
+{
+public:
+	class Writer;
+
+	ProjectCache(const std::string &projectFile);
+	~ProjectCache();
+	bool isValid() const { return valid; }
+	FrameRate getFrameRate() const;
+	size_t getEntriesNum() const;
+	Interval getEntryInterval(size_t id) const;
+	const char *getEntryResource(size_t id) const;
+	FeatureList *createFeatureList() const;
+
+	static std::string pathFor(const std::string &projectFile);
+private:
+	struct Header
+	{
+		char magic[4];
+		uint32_t version;
+		uint64_t sourceSize;
+		int64_t sourceMtime;
+		uint64_t sourceHash;
+		uint64_t bodyHash;
+		int32_t frameRateNum;
+		int32_t frameRateDen;
+		uint32_t entriesNum;
+		uint32_t featuresNum;
+		uint64_t intervalsNum;
+		uint64_t stringsSize;
+	};
+	struct CachedInterval
+	{
+		int64_t in;
+		int64_t out;
+		int8_t intensity;
+		uint8_t reserved[7];
+	};
+	struct CachedEntry
+	{
+		CachedInterval interval;
+		uint64_t resource;
+	};
+	struct CachedFeature
+	{
+		uint64_t name;
+		uint64_t description;
+		uint64_t action;
+		uint64_t eq;
+		uint64_t firstInterval;
+		uint64_t intervalsNum;
+		int8_t recIntensity;
+		uint8_t reserved[7];
+	};
+
+	MappedFile *file;
+	bool valid;
+	const Header *header;
+	const CachedEntry *entries;
+	const CachedFeature *features;
+	const CachedInterval *intervals;
+	const char *strings;
+
+	bool validate(const std::string &projectFile);
+	const char *getString(uint64_t offset) const { return strings + offset; }
+};
+
+class ProjectCache::Writer
+{
+public:
+	Writer(const FrameRate &frameRate): frameRate(frameRate) {}
+	void addEntry(const Interval &interval, const std::string &resource);
+	void addFeature(const Feature &feature);
+	void addFeatureInterval(const Interval &interval);
+	bool write(const std::string &projectFile) const;
+private:
+	FrameRate frameRate;
+	std::vector<CachedEntry> entries;
+	std::vector<CachedFeature> features;
+	std::vector<CachedInterval> intervals;
+	std::string strings;
+	std::unordered_map<std::string, uint64_t> stringIndex;
+
+	uint64_t addString(const std::string &str);
+};
+
+}
+
+#endif // NTFF_CACHE_H
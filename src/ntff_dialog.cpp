@@ -1,6 +1,7 @@
 #include "ntff_dialog.h"
 #include "ntff_feature.h"
 #include "ntff_player.h"
+#include "ntff_selection.h"
 #include <vlc_common.h>
 #include <vlc_dialog.h>
 #include <vlc_extensions.h>
@@ -12,6 +13,17 @@
 
 namespace Ntff {
 
+static std::string formatTime(mtime_t time) //copied from StreamTime::formatTime
+{
+	int seconds = time / 1000000;
+	char psz_time[MSTRTIME_MAX_SIZE];
+	snprintf( psz_time, MSTRTIME_MAX_SIZE, "%d:%02d:%02d",
+			  (int) (seconds / (60 * 60)),
+			  (int) (seconds / 60 % 60),
+			  (int) (seconds % 60) );
+    return std::string(psz_time);
+}
+
 class Widget
 {
 	friend class ComplexWidget;
@@ -118,6 +130,19 @@ public:
 		}
 		return 0;
 	}
+	void updateValues(const std::vector<std::string> &values) //the same number of them
+	{
+		extension_widget_t::extension_widget_value_t *cur = widget->p_values;
+		for (const std::string &value: values)
+		{
+			if (!cur) { break; }
+			delete[] cur->psz_text;
+			cur->psz_text = new char[value.size() + 1];
+			strcpy(cur->psz_text, value.c_str());
+			cur = cur->p_next;
+		}
+		widget->b_update = true;
+	}
 protected:
 	void fillValues(const std::vector<std::string> &values)
 	{
@@ -194,7 +219,6 @@ private:
 class FeatureWidget: public ComplexWidget
 {
 public:
-	enum {Less, More, LessOrEq, MoreOrEq};
 	FeatureWidget(extension_dialog_t *dialog, Feature *feature, int row): feature(feature)
 	{
 		addWidget(new Label(dialog, "then", row));
@@ -215,7 +239,9 @@ public:
 		equality = new Combobox(dialog, "", eqStr, row);
 		addWidget(equality);
 		
-		value = new Combobox(dialog, "", feature->getIntervalsIntensity(), row);
+		valueTexts = feature->getIntervalsIntensity();
+		for (const std::string &text: valueTexts) { intensities.push_back(atoi(text.c_str())); }
+		value = new Combobox(dialog, "", valueTexts, row);
 		addWidget(value);
 		
 		unmarked = new Checkbox(dialog, "", false, row);
@@ -226,22 +252,10 @@ public:
 		restore();
 	}
 	
-	void getSelectedIntensity(int8_t &min, int8_t &max)
+	SelectionRule getRule() const
 	{
-		int eq = equality->getSelectedId();
-		int8_t intensity = (int8_t)value->getValue();
-		if (eq == Less || eq == LessOrEq)
-		{
-			min = std::numeric_limits<int8_t>::min();
-			max = intensity;
-			if (eq == Less) { max--; }
-		}
-		else
-		{
-			max = std::numeric_limits<int8_t>::max();
-			min = intensity;
-			if (eq == More) { min++; }
-		}
+		return SelectionRule{feature, addCmd(), (Comparison)equality->getSelectedId(), 
+			(int8_t)value->getValue(), affectUnmarked()};
 	}
 	
 	bool update()
@@ -264,7 +278,7 @@ public:
 	}
 	void restore()
 	{
-		value->updateText(std::to_string(feature->getRecIntensity()));
+		value->updateText(getValueText(feature->getRecIntensity()));
 		std::string eq = (std::find(eqStr.begin(), eqStr.end(), feature->getEq()) != eqStr.end()) ? 
 			feature->getEq() : eqStr[0];
 		equality->updateText(eq);
@@ -273,6 +287,23 @@ public:
 		updateUnmarkedColor();
 	}
 	Feature *getFeature() const { return feature; }
+	
+	//every value shows play length the selection would have with it
+	void updateLengths(const SelectionLengths &lengths, size_t rule, const Player *player)
+	{
+		Comparison eq = (Comparison)equality->getSelectedId();
+		std::vector<std::string> texts;
+		for (int8_t intensity: intensities)
+		{
+			mtime_t length = player->getFramesTime(lengths.get(rule, eq, intensity));
+			texts.push_back(std::to_string(intensity) + " (" + formatTime(length) + ")");
+		}
+		if (texts == valueTexts) { return; }
+		int8_t selected = value->getValue();
+		valueTexts = texts;
+		value->updateValues(valueTexts);
+		value->updateText(getValueText(selected));
+	}
 private:
 	Feature *feature;
 	Label *name;
@@ -282,6 +313,15 @@ private:
 	Checkbox *unmarked;
 	Label *unmarkedLabel;
 	std::vector<std::string> eqStr;
+	std::vector<int8_t> intensities; //of values
+	std::vector<std::string> valueTexts; //intensity and play length with it
+	
+	std::string getValueText(int8_t intensity) const
+	{
+		auto found = std::find(intensities.begin(), intensities.end(), intensity);
+		if (found == intensities.end()) { return std::to_string(intensity); }
+		return valueTexts[found - intensities.begin()];
+	}
 	
 	void updateNameColor()
 	{
@@ -321,6 +361,7 @@ static void TimerCallback(void *ptr)
 Dialog::Dialog(Player *player, const FeatureList *featureList) : 
 	player(player), shown(false)
 {
+	vlc_mutex_init(&selectionMutex);
 	name = "Ntff Settings";
 	dialog = new extension_dialog_t();
 	dialog->p_object = player->getVlcObj();
@@ -329,6 +370,8 @@ Dialog::Dialog(Player *player, const FeatureList *featureList) :
 	dialog->p_sys_intf = NULL;
 	dialog->b_hide = false;
 	dialog->b_kill = false;
+	vlc_mutex_init(&dialog->lock); //taken by Qt while it reads or changes widgets
+	vlc_cond_init(&dialog->cond);
 	
 	int row = 0;
 	
@@ -376,9 +419,15 @@ Dialog::Dialog(Player *player, const FeatureList *featureList) :
 Dialog::~Dialog()
 {
 	var_DelCallback(player->getVlcObj(), "dialog-event", DialogCallback, this);
+	if (timerOk) { vlc_timer_destroy(updateLengthTimer); }
+	vlc_mutex_lock(&dialog->lock);
 	dialog->b_kill = true;
 	vlc_ext_dialog_update(player->getVlcObj(), dialog);
-	if (timerOk) { vlc_timer_destroy(updateLengthTimer); }
+	while (dialog->p_sys_intf) { vlc_cond_wait(&dialog->cond, &dialog->lock); } //Qt lets it go
+	vlc_mutex_unlock(&dialog->lock);
+	vlc_cond_destroy(&dialog->cond);
+	vlc_mutex_destroy(&dialog->lock);
+	vlc_mutex_destroy(&selectionMutex);
 }
 
 void Dialog::buttonPressed(extension_widget_t *widgetPtr)
@@ -410,8 +459,10 @@ void Dialog::hide() //need to hide from other thread than DialogCallback
 	if (shown == true)
 	{
 		shown = false;
+		vlc_mutex_lock(&dialog->lock);
 		dialog->b_hide = true;
 		vlc_ext_dialog_update(player->getVlcObj(), dialog);
+		vlc_mutex_unlock(&dialog->lock);
 	}
 }
 
@@ -420,17 +471,6 @@ void Dialog::appendWidgets(ComplexWidget *src)
 	widgets.insert(widgets.end(), src->getWidgets().begin(), src->getWidgets().end());
 }
 
-std::string Dialog::formatTime(mtime_t time) const //copied from StreamTime::formatTime
-{
-	int seconds = time / 1000000;
-	char psz_time[MSTRTIME_MAX_SIZE];
-	snprintf( psz_time, MSTRTIME_MAX_SIZE, "%d:%02d:%02d",
-			  (int) (seconds / (60 * 60)),
-			  (int) (seconds / 60 % 60),
-			  (int) (seconds % 60) );
-    return std::string(psz_time);
-}
-
 int Dialog::getMaxColumn() const
 {
 	int res = 0;
@@ -453,32 +493,55 @@ bool Dialog::updatedFeatures()
 
 void Dialog::applyUserSelection(bool force)
 {
+	//widgets are read and changed under the lock of the dialog, Qt goes through them under it
+	vlc_mutex_lock(&selectionMutex);
+	vlc_mutex_lock(&dialog->lock);
 	bool beginChanged = beginAction->changed();
 	if (updatedFeatures() || beginChanged || force)
 	{
-		player->lockIntervals(true);
-		player->resetIntervals(beginAction->getAction() == UserAction::Remove);
-		std::map<int, FeatureWidget *> orderedFeatures;
-		for (FeatureWidget *widget: featureWidgets)
-		{
-			orderedFeatures[widget->getRow()] = widget;
-		}
+		//new intervals are found and published without intervalsMutex, demux thread goes on meanwhile
+		Selection selection;
+		getSelection(selection);
+		vlc_mutex_unlock(&dialog->lock);
+		IntervalSet *intervals = new IntervalSet();
+		player->lockFeatures(true);
+		selectionCache.apply(selection, *intervals, player->getWholeDuration());
+		selectionLengths.update(selection, selectionCache, player->getWholeDuration());
+		player->lockFeatures(false);
+		msg_Dbg(player->getVlcObj(), "Selection: %zu of %zu rules reused", selectionCache.getReusedNum(),
+			selection.getRules().size());
 		
-		for (auto p: orderedFeatures)
-		{
-			FeatureWidget *widget = p.second;
-			int8_t min, max;
-			widget->getSelectedIntensity(min, max);
-			player->modifyIntervals(widget->addCmd(), widget->getFeature(), min, max, widget->affectUnmarked());
-		}
-		
-		player->recalcLength();
-		mtime_t length = player->getLength();
+		mtime_t length = player->getFramesTime(intervals->length());
+		player->publishPlayIntervals(intervals);
+		vlc_mutex_lock(&dialog->lock);
 		playLength->updateText(formatTime(length));
+		std::vector<FeatureWidget *> rows = getOrderedWidgets();
+		for (size_t i = 0; i < rows.size(); i++) { rows[i]->updateLengths(selectionLengths, i, player); }
 		vlc_ext_dialog_update(player->getVlcObj(), dialog);
-		player->updateCurrentInterval();
-		player->lockIntervals(false);
 	}
+	vlc_mutex_unlock(&dialog->lock);
+	vlc_mutex_unlock(&selectionMutex);
+}
+
+void Dialog::getSelection(Selection &selection) const
+{
+	selection.setBeginAction(beginAction->getAction() == UserAction::Add);
+	for (FeatureWidget *widget: getOrderedWidgets())
+	{
+		selection.append(widget->getRule());
+	}
+}
+
+std::vector<FeatureWidget *> Dialog::getOrderedWidgets() const //as rules of selection
+{
+	std::map<int, FeatureWidget *> orderedFeatures;
+	for (FeatureWidget *widget: featureWidgets)
+	{
+		orderedFeatures[widget->getRow()] = widget;
+	}
+	std::vector<FeatureWidget *> res;
+	for (auto p: orderedFeatures) { res.push_back(p.second); }
+	return res;
 }
 
 
@@ -4,7 +4,9 @@
 #include <string>
 #include <list>
 #include <map>
+#include <vector>
 #include <vlc_common.h>
+#include "ntff_selection.h"
 
 struct extension_dialog_t;
 struct extension_widget_t;
@@ -31,6 +33,7 @@ public:
 	void hide();
 	bool isShown() const { return shown; }
 	void applyUserSelection(bool force = false);
+	void getSelection(Selection &selection) const;
 private:
 	Player *player;
 	extension_dialog_t *dialog;
@@ -44,11 +47,14 @@ private:
 	vlc_timer_t updateLengthTimer;
 	bool timerOk;
 	UserAction *beginAction;
+	SelectionCache selectionCache;
+	SelectionLengths selectionLengths; //of every value of rows, shown next to it
+	vlc_mutex_t selectionMutex; //user and project reload apply selection from different threads
 	
 	int getMaxColumn() const;
 	bool updatedFeatures();
 	void appendWidgets(ComplexWidget *src);
-	std::string formatTime(mtime_t time) const;
+	std::vector<FeatureWidget *> getOrderedWidgets() const;
 };
 
 }
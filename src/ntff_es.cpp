@@ -5,6 +5,7 @@
 #include <vlc_codec.h>
 #include <vlc_input.h>
 #include <functional>
+#include <algorithm>
 using atomic_bool = bool;
 #include <input/input_internal.h>
 
@@ -66,12 +67,18 @@ struct es_out_id_t
 namespace Ntff 
 {
 
+thread_local OutStream::Probe OutStream::probe = {false, false, 0, 0, 0};
+thread_local size_t OutStream::cursors[EStreamTypeNum] = {};
+
 OutStream::OutStream(es_out_t *out, Player *player) : 
 	BaseStream(out, player)
 {
 	curTime = 0;
+	baseTime = 0;
+	timeFrames = 0;
 	outputEnabled = false;
 	lastBlockTime = 0;
+	vlc_mutex_init(&streamsMutex);
 	wrapper.p_sys = (es_out_sys_t *)this;
 	
 	wrapper.pf_add = [] (es_out_t *out, const es_format_t *format)
@@ -100,15 +107,44 @@ OutStream::OutStream(es_out_t *out, Player *player) :
 	};
 }
 
+OutStream::~OutStream()
+{
+	for (PendingStream *stream: pending)
+	{
+		es_format_Clean(&stream->format);
+		delete stream;
+	}
+	vlc_mutex_destroy(&streamsMutex);
+}
+
+void OutStream::reuseStreams() //cursors of calling thread, items of other threads are not affected
+{
+	for (size_t &cursor: cursors) { cursor = 0; }
+}
+
+void OutStream::beginProbe()
+{
+	probe = Probe{true, false, 0, 0, 0};
+}
+
+OutStream::Probe OutStream::endProbe()
+{
+	probe.active = false;
+	return probe;
+}
+
 mtime_t OutStream::updateTime()
 {
-	curTime += player->getFrameLen();
+	//counted from last setTime, so frame durations are not rounded and accumulated
+	curTime = baseTime + player->getFramesTime(++timeFrames);
 	return curTime;
 }
 
 void OutStream::setTime(mtime_t time)
 {
 	curTime = time;
+	baseTime = time;
+	timeFrames = 0;
 	resetFramesNum();
 	es_out_Control(out, ES_OUT_RESET_PCR);
 }
@@ -122,31 +158,120 @@ frame_id OutStream::getHandledFrameId() const
 es_out_id_t *OutStream::addElemental(const es_format_t *format)
 {
 	EStreamType type = EStreamCollection::typeByVlcFormat(format);
-	es_out_id_t *res = streams.getNext(type);
-	
-	if (!res)
+	if (probe.active && type == Video && !probe.frameRate)
+	{
+		probe.frameRate = format->video.i_frame_rate;
+		probe.frameRateBase = format->video.i_frame_rate_base;
+	}
+	vlc_mutex_lock(&streamsMutex);
+	es_out_id_t *res = streams.get(type, cursors[type]);
+	if (!res && probe.active) //VLC is not touched from the probing thread
+	{
+		PendingStream *stream = new PendingStream{es_format_t(), type, nullptr};
+		es_format_Copy(&stream->format, format);
+		pending.push_back(stream);
+		res = (es_out_id_t *)stream;
+		streams.append(res, type);
+	}
+	else if (!res)
 	{
 		res = out->pf_add(out, format);
 		streams.append(res, type);
 		//msg_Dbg(player->getVlcObj(), "~~~~addElemental %s", (type == Video ? "VIDEO" : "AUDIO"));
 	}
+	cursors[type] = std::min(cursors[type] + 1, streams.size(type));
+	vlc_mutex_unlock(&streamsMutex);
 	
 	return res;
 }
 
+OutStream::PendingStream *OutStream::findPending(es_out_id_t *id) const
+{
+	for (PendingStream *stream: pending)
+	{
+		if ((es_out_id_t *)stream == id) { return stream; }
+	}
+	return nullptr;
+}
+
+EStreamType OutStream::resolve(es_out_id_t *&id, bool add)
+{
+	vlc_mutex_lock(&streamsMutex);
+	EStreamType res = streams.getType(id);
+	PendingStream *stream = add ? findPending(id) : nullptr;
+	if (stream)
+	{
+		if (!stream->id) { stream->id = out->pf_add(out, &stream->format); }
+		id = stream->id;
+	}
+	vlc_mutex_unlock(&streamsMutex);
+	return res;
+}
+
 void OutStream::removeElemental(es_out_id_t *id)
 {
-	out->pf_del(out, id);
+	vlc_mutex_lock(&streamsMutex);
+	PendingStream *stream = findPending(id);
+	if (stream) { id = stream->id; } //not added yet, if nullptr
+	vlc_mutex_unlock(&streamsMutex);
+	if (id) { out->pf_del(out, id); }
 }
 
 int OutStream::control(int i_query, va_list va)
 {
 	//msg_Dbg(player->getVlcObj(), "~~~~control query: %i", i_query);
+	if (probe.active) { return VLC_EGENERIC; } //as output without the query, playback is not affected
 	if (i_query == ES_OUT_SET_NEXT_DISPLAY_TIME || i_query == ES_OUT_SET_PCR)
 	{
 		return VLC_SUCCESS;
 	}
-	else return out->pf_control(out, i_query, va);
+	switch (i_query)
+	{
+		case ES_OUT_SET_ES:
+		case ES_OUT_RESTART_ES:
+		case ES_OUT_SET_ES_DEFAULT:
+		case ES_OUT_SET_ES_STATE:
+		case ES_OUT_GET_ES_STATE:
+		case ES_OUT_SET_ES_FMT:
+		case ES_OUT_SET_ES_SCRAMBLED_STATE:
+		{
+			va_list args;
+			va_copy(args, va);
+			es_out_id_t *id = va_arg(args, es_out_id_t *);
+			es_out_id_t *resolved = id;
+			resolve(resolved, true);
+			int res = (resolved == id) ? out->pf_control(out, i_query, va) :
+				controlStream(i_query, resolved, args);
+			va_end(args);
+			return res;
+		}
+		default: return out->pf_control(out, i_query, va);
+	}
+}
+
+//same query with stream of VLC instead of pending one, args are after the stream
+int OutStream::controlStream(int i_query, es_out_id_t *id, va_list args)
+{
+	switch (i_query)
+	{
+		case ES_OUT_SET_ES_STATE:
+		case ES_OUT_SET_ES_SCRAMBLED_STATE:
+		{
+			bool state = (bool)va_arg(args, int);
+			return es_out_Control(out, i_query, id, state);
+		}
+		case ES_OUT_GET_ES_STATE:
+		{
+			bool *state = va_arg(args, bool *);
+			return es_out_Control(out, i_query, id, state);
+		}
+		case ES_OUT_SET_ES_FMT:
+		{
+			const es_format_t *format = va_arg(args, const es_format_t *);
+			return es_out_Control(out, i_query, id, format);
+		}
+		default: return es_out_Control(out, i_query, id);
+	}
 }
 
 void OutStream::destroyOutStream()
@@ -176,10 +301,23 @@ void OutStream::addFrame(frame_id frame)
 int OutStream::sendBlock(es_out_id_t *streamId, block_t *block)
 {
 	mtime_t blockTime = (block->i_pts == 0) ? block->i_dts : block->i_pts;
+	es_out_id_t *resolved = streamId;
+	EStreamType type = resolve(resolved, outputEnabled && !probe.active);
+	if (probe.active)
+	{
+		if (!probe.done && type == Video)
+		{
+			probe.done = true;
+			probe.time = blockTime;
+		}
+		block_Release(block);
+		return VLC_SUCCESS;
+	}
+	
 	frame_id curFrameId = player->getFrameId(blockTime);
 	frame_id frameInInterval = curFrameId - player->getCurIntervalFirstFrame();
 	
-	if (isVideo(streamId))
+	if (type == Video)
 	{
 		if (outputEnabled) { addFrame(frameInInterval); }		
 		block->i_dts = getTime();
@@ -189,14 +327,14 @@ int OutStream::sendBlock(es_out_id_t *streamId, block_t *block)
 		}
 		lastBlockTime = blockTime;
 	}
-	else if (isAudio(streamId))
+	else if (type == Audio)
 	{
 		block->i_dts = block->i_pts = getTime();
 	}
 	
 	if (player->frameIsInPlayInterval(curFrameId))
 	{
-		if (isVideo(streamId))
+		if (type == Video)
 		{
 			mtime_t time = updateTime();
 			es_out_Control(out, ES_OUT_SET_PCR, time);
@@ -206,11 +344,11 @@ int OutStream::sendBlock(es_out_id_t *streamId, block_t *block)
 	}
 	else
 	{
-		if (isAudio(streamId))
+		if (type == Audio)
 		{
 			return VLC_SUCCESS;
 		}
-		else if (isVideo(streamId))
+		else if (type == Video)
 		{
 			block->i_pts = getTime() + frameInInterval;
 			block->i_flags |= BLOCK_FLAG_PRIVATE_SKIP_VIDEOBLOCK;
@@ -220,43 +358,28 @@ int OutStream::sendBlock(es_out_id_t *streamId, block_t *block)
 	
 	if (outputEnabled)
 	{
-		return out->pf_send(out, streamId, block);
+		return out->pf_send(out, resolved, block);
 	}
 	else { return VLC_SUCCESS; }
 }
 
-void EStreamCollection::reuse()
+es_out_id_t *EStreamCollection::get(EStreamType type, size_t index) const
 {
-	for (int i = 0; i < EStreamTypeNum; i++)
-	{
-		streamIt[i] = streams[i].begin();
-	}
-}
-
-es_out_id_t *EStreamCollection::getNext(EStreamType type)
-{
-	if (type == Unknown || streamIt[type] == streams[type].end()) { return nullptr; }
-	else 
-	{
-		es_out_id_t *res = *streamIt[type];
-		streamIt[type]++;
-		return res;
-	}
+	if (type == Unknown || index >= streams[type].size()) { return nullptr; }
+	return streams[type][index];
 }
 
 void EStreamCollection::append(es_out_id_t *id, EStreamType type)
 {
 	if (type == Unknown) return;
-	
-	streams[type].insert(id);
-	streamIt[type] = streams[type].end();
+	streams[type].push_back(id);
 }
 
 EStreamType EStreamCollection::getType(es_out_id_t *stream) const
 {
 	for (int i = 0; i < EStreamTypeNum; i++)
 	{
-		if (streams[i].count(stream)) { return (EStreamType)i; }
+		if (std::find(streams[i].begin(), streams[i].end(), stream) != streams[i].end()) { return (EStreamType)i; }
 	}
 	return Unknown;
 }
@@ -420,7 +543,7 @@ int PreloadVideoStream::control(int i_query, va_list va)
 void PreloadVideoStream::setTargetTime(mtime_t time) 
 {
 	targetFrame = player->getFrameId(time);
-	firstTimestamp = player->getStreamLengthTo(targetFrame) * player->getFrameLen();
+	firstTimestamp = player->getFramesTime(player->getStreamLengthTo(targetFrame));
 	msg_Dbg(player->getVlcObj(), "PreloadVideoStream firstTimestamp %li", firstTimestamp);
 	done = false;
 }
@@ -2,6 +2,7 @@
 #define NTFF_ES_H_INCLUDED
 
 #include <set>
+#include <vector>
 #include <vlc_common.h>
 #include <vlc_es_out.h>
 #include "ntff_feature.h"
@@ -17,19 +18,19 @@ enum EStreamType
 	EStreamTypeNum
 };
 
+/* Streams of the output shared by items: n-th video (audio) stream of every item
+ * is the n-th one here. Every thread goes through them with its own cursors. */
 class EStreamCollection
 {
 public:
-	EStreamCollection() { reuse(); }
-	void reuse();
-	es_out_id_t *getNext(EStreamType type);
+	es_out_id_t *get(EStreamType type, size_t index) const; //nullptr if there is none
+	size_t size(EStreamType type) const { return (type == Unknown) ? 0 : streams[type].size(); }
 	void append(es_out_id_t *id, EStreamType type);
 	EStreamType getType(es_out_id_t *stream) const;	
 	
 	static EStreamType typeByVlcFormat(const es_format_t *format);
 private:
-	std::set<es_out_id_t *> streams[EStreamTypeNum];
-	std::set<es_out_id_t *>::iterator streamIt[EStreamTypeNum];
+	std::vector<es_out_id_t *> streams[EStreamTypeNum]; //in order of adding
 };
 
 class BaseStream
@@ -46,17 +47,31 @@ protected:
 class OutStream: public BaseStream
 {
 public: 
+	struct Probe
+	{
+		bool active;
+		bool done;
+		mtime_t time; //of the first video block
+		unsigned frameRate; //of the first video stream added
+		unsigned frameRateBase;
+	};
+	
 	OutStream(es_out_t *out, Player *player);
+	~OutStream();
 	
-	bool isVideo(es_out_id_t *stream) const { return streams.getType(stream) == Video; }
-	bool isAudio(es_out_id_t *stream) const { return streams.getType(stream) == Audio; }
 	mtime_t updateTime();
 	void resetFramesNum() { framesQueue.clear(); }
 	void setTime(mtime_t time);
 	mtime_t getTime() const { return curTime; }
 	mtime_t getLastBlockTime() const { return lastBlockTime; }
 	frame_id getHandledFrameId() const;
-	void reuseStreams() { streams.reuse(); }
+	void reuseStreams();
+	
+	//blocks and queries of calling thread are swallowed until first video block is seen,
+	//so items may be probed in background while the first one plays
+	static void beginProbe();
+	static bool probeDone() { return probe.done; }
+	static Probe endProbe();
 	
 	es_out_id_t *addElemental(const es_format_t *format);
 	void removeElemental(es_out_id_t *id);
@@ -65,13 +80,32 @@ public:
 	void destroyOutStream();
 	void enableOutput() { outputEnabled = true; }
 private:
-	EStreamCollection streams;
+	//added by a probed item beyond the shared streams, given to VLC on first use
+	struct PendingStream
+	{
+		es_format_t format;
+		EStreamType type;
+		es_out_id_t *id;
+	};
+	static thread_local Probe probe;
+	static thread_local size_t cursors[EStreamTypeNum]; //next shared stream for the item being created
+	
+	EStreamCollection streams; //pending streams are there as pointers to PendingStream
+	std::vector<PendingStream *> pending;
+	mutable vlc_mutex_t streamsMutex; //items are created from several threads
 	mtime_t curTime;
+	mtime_t baseTime;
+	frame_id timeFrames;
 	mtime_t lastBlockTime;
 	std::set<frame_id> framesQueue;
 	bool outputEnabled;
 	
 	void addFrame(frame_id frame);
+	PendingStream *findPending(es_out_id_t *id) const; //under streamsMutex
+	//type of a stream given to an item and the stream of VLC for it, under one lock;
+	//a pending stream is given to VLC here when add is set, otherwise id stays as it is
+	EStreamType resolve(es_out_id_t *&id, bool add);
+	int controlStream(int i_query, es_out_id_t *id, va_list args); //query about one stream
 };
 
 class PreloadVideoStream: public BaseStream
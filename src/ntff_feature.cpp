@@ -1,5 +1,7 @@
 #include "ntff_feature.h"
+#include "ntff_intervals.h"
 #include <limits>
+#include <algorithm>
 #include <iostream>
 
 namespace Ntff 
@@ -8,110 +10,257 @@ namespace Ntff
 Feature::Feature(const std::string &name, const std::string &description, 
 	const std::string &recAction, const std::string &recEq, int8_t recIntensity):
 	name(name), description(description),
-	recIntensity(recIntensity), recAction(recAction), recEq(recEq)
+	recIntensity(recIntensity), recAction(recAction), recEq(recEq), intervalsLength(0), revision(0), index(nullptr)
 {
 	min = std::numeric_limits<int8_t>::max();
 	max = std::numeric_limits<int8_t>::min();
 }
 
-void Feature::appendInterval(const Ntff::Interval &interval) 
+/* Intervals of every intensity merged apart, so a threshold is a lookup of unions
+ * made once. Unions are keyed by intensities present, "> 2" and ">= 3" share one. */
+struct Feature::IntensityIndex
 {
-	intervals.push_back(interval);
-	min = std::min(min, interval.intensity);
-	max = std::max(min, interval.intensity);
+	std::map<int8_t, IntervalSet> buckets;
+	std::map<std::pair<int8_t, int8_t>, IntervalSet> unions;
+	IntervalSet empty;
+	IntervalSet unmarked;
+	frame_id unmarkedDuration = -1; //unmarked is not built yet
+	//marked frames split by the highest (lowest) intensity of intervals there, sorted and disjoint
+	std::vector<Interval> highest;
+	std::vector<Interval> lowest;
+	bool layersBuilt = false;
+};
+
+Feature::~Feature()
+{
+	delete index;
 }
 
-std::vector<std::string> Feature::getIntervalsIntensity() const
+void Feature::resetIndex()
 {
-	std::set<std::string> res;
-	for (const Interval &interval: intervals)
-	{
-		res.insert(std::to_string((int)interval.intensity));
-	}
-	return std::vector<std::string>(res.begin(), res.end());
+	std::lock_guard<std::mutex> lock(indexMutex);
+	delete index;
+	index = nullptr;
 }
 
-FeatureList::~FeatureList()
+void Feature::buildIndex() const
 {
-	for (Feature *feature: *this)
+	if (index) { return; }
+	index = new IntensityIndex();
+	std::map<int8_t, std::vector<Interval>> byIntensity;
+	for (const Interval &interval: intervals) { byIntensity[interval.intensity].push_back(interval); }
+	for (auto &p: byIntensity)
 	{
-		delete feature;
+		index->buckets[p.first] = IntervalSet::fromIntervals(p.second, p.first, p.first);
 	}
 }
 
-void FeatureList::insertInterval(std::map<frame_id, Interval> &container, const Interval &interval)
+//one sweep over starts and ends of intervals, intervals over a frame are counted by intensity
+void Feature::buildLayers() const
 {
-	if (container.empty()) { container[interval.in] = interval; return; }
-	
-	Interval res = interval;
-		
-	auto faffected = container.lower_bound(interval.in);
-	if (faffected == container.end() || 
-		(faffected->second.in > interval.in && faffected != container.begin())) //maybe need change prev
+	buildIndex();
+	if (index->layersBuilt) { return; }
+	std::vector<std::pair<frame_id, int8_t>> starts, ends;
+	starts.reserve(intervals.size());
+	ends.reserve(intervals.size());
+	for (const Interval &interval: intervals)
 	{
-		faffected--;
-		if (faffected->second.out > interval.in) { res.in = faffected->second.in; }
-		res.out = std::max(res.out, faffected->second.out);
-		faffected++;
+		if (interval.in >= interval.out) { continue; }
+		starts.push_back(std::make_pair(interval.in, interval.intensity));
+		ends.push_back(std::make_pair(interval.out, interval.intensity));
 	}
+	std::sort(starts.begin(), starts.end());
+	std::sort(ends.begin(), ends.end());
 	
-	auto laffected = container.lower_bound(interval.out);
-	if (laffected != container.end() && laffected->second.in == interval.out)
+	uint32_t counts[256] = {}; //by intensity + 128
+	uint64_t present[4] = {}; //bit per intensity with count > 0
+	auto appendLayer = [](std::vector<Interval> &layers, frame_id in, frame_id out, int intensity)
 	{
-		res.out = laffected->second.out;
-		laffected++;
+		if (!layers.empty() && layers.back().out == in && layers.back().intensity == intensity) { layers.back().out = out; }
+		else { layers.push_back(Interval(in, out, intensity)); }
+	};
+	size_t i = 0, j = 0, active = 0;
+	frame_id prev = 0;
+	while (j < ends.size())
+	{
+		frame_id pos = (i < starts.size()) ? std::min(starts[i].first, ends[j].first) : ends[j].first;
+		if (active && pos > prev)
+		{
+			int highest = 0, lowest = 0;
+			for (int w = 3; w >= 0; w--) { if (present[w]) { highest = w * 64 + 63 - __builtin_clzll(present[w]); break; } }
+			for (int w = 0; w < 4; w++) { if (present[w]) { lowest = w * 64 + __builtin_ctzll(present[w]); break; } }
+			appendLayer(index->highest, prev, pos, highest - 128);
+			appendLayer(index->lowest, prev, pos, lowest - 128);
+		}
+		for (; i < starts.size() && starts[i].first == pos; i++, active++)
+		{
+			int bit = starts[i].second + 128;
+			if (counts[bit]++ == 0) { present[bit / 64] |= 1ull << (bit % 64); }
+		}
+		for (; j < ends.size() && ends[j].first == pos; j++, active--)
+		{
+			int bit = ends[j].second + 128;
+			if (--counts[bit] == 0) { present[bit / 64] &= ~(1ull << (bit % 64)); }
+		}
+		prev = pos;
 	}
-	else if (laffected != container.begin())
+	index->layersBuilt = true;
+}
+
+//one merge of the set with every layer, lengths are summed by intensity of the layer
+static void addLayerLengths(const std::vector<Interval> &layers, const IntervalSet &frames, frame_id *lengths)
+{
+	size_t i = 0, j = 0;
+	while (i < layers.size() && j < frames.size())
 	{
-		laffected--;
-		res.out = std::max(res.out, laffected->second.out);
-		laffected++;
+		frame_id in = std::max(layers[i].in, frames.getIn(j));
+		frame_id out = std::min(layers[i].out, frames.getOut(j));
+		if (in < out) { lengths[layers[i].intensity + 128] += out - in; }
+		if (layers[i].out < frames.getOut(j)) { i++; }
+		else { j++; }
 	}
-	container.erase(faffected, laffected);
-	container[res.in] = res;
 }
 
-void FeatureList::removeInterval(std::map<frame_id, Interval> &container, const Interval &interval)
+void Feature::getIntensityLengths(const IntervalSet &frames, std::map<int8_t, frame_id> &byHighest,
+	std::map<int8_t, frame_id> &byLowest) const
 {
-	if (container.empty()) { return; }
-	
-	auto faffected = container.upper_bound(interval.in);  //maybe need change .out of prev
-	if (faffected == container.begin()) { return; }
-	faffected--;
-	Interval &fint = faffected->second;
-	bool done = false;
-	if (fint.out > interval.out) 
+	std::lock_guard<std::mutex> lock(indexMutex);
+	buildLayers();
+	frame_id highest[256] = {}, lowest[256] = {}; //by intensity + 128
+	addLayerLengths(index->highest, frames, highest);
+	addLayerLengths(index->lowest, frames, lowest);
+	byHighest.clear();
+	byLowest.clear();
+	for (const auto &bucket: index->buckets)
 	{
-		container[interval.out] = Interval(interval.out, fint.out);
-		done = true;
+		byHighest[bucket.first] = highest[bucket.first + 128];
+		byLowest[bucket.first] = lowest[bucket.first + 128];
 	}
-	if (fint.out > interval.in) 
+}
+
+void Feature::prepareIndex(frame_id wholeDuration) const
+{
+	getUnmarked(wholeDuration);
+	std::lock_guard<std::mutex> lock(indexMutex);
+	buildLayers();
+}
+
+const IntervalSet &Feature::getUnmarked(frame_id wholeDuration) const
+{
+	const IntervalSet &marked = getIntervalsUnion(std::numeric_limits<int8_t>::min(),
+		std::numeric_limits<int8_t>::max());
+	std::lock_guard<std::mutex> lock(indexMutex);
+	if (index->unmarkedDuration != wholeDuration)
 	{
-		fint.out = interval.in; 
+		index->unmarked = marked.complement(wholeDuration);
+		index->unmarkedDuration = wholeDuration;
 	}
-	faffected++;
-	if (fint.length() == 0) { container.erase(fint.in); }
-	if (done) { return; }
+	return index->unmarked;
+}
+
+const IntervalSet &Feature::getIntervalsUnion(int8_t minIntensity, int8_t maxIntensity) const
+{
+	std::lock_guard<std::mutex> lock(indexMutex);
+	buildIndex();
+	if (minIntensity > maxIntensity) { return index->empty; } //empty range of a rule
 	
-	auto laffected = container.lower_bound(interval.out);
-	Interval shortened;
-	if (laffected != container.begin()) //maybe need change .in of prev
+	auto first = index->buckets.lower_bound(minIntensity);
+	auto last = index->buckets.upper_bound(maxIntensity);
+	if (first == last) { return index->empty; }
+	std::pair<int8_t, int8_t> key(first->first, std::prev(last)->first);
+	auto found = index->unions.find(key);
+	if (found != index->unions.end()) { return found->second; }
+	
+	IntervalSet &res = index->unions[key];
+	for (auto it = first; it != last; it++) { res.unite(it->second); }
+	return res;
+}
+
+void Feature::appendInterval(const Ntff::Interval &interval) 
+{
+	intervals.push_back(interval);
+	intervalsLength += interval.length();
+	revision++;
+	resetIndex();
+	min = std::min(min, interval.intensity);
+	max = std::max(min, interval.intensity);
+}
+
+void Feature::setIntervals(const std::vector<Interval> &value)
+{
+	intervals = value;
+	intervalsLength = 0;
+	revision++;
+	resetIndex();
+	for (const Interval &interval: intervals) { intervalsLength += interval.length(); }
+}
+
+//columns are copied in one pass, intervals are kept sorted when merged with existing ones
+void Feature::appendIntervals(const frame_id *in, const frame_id *out, const int8_t *intensity, size_t num)
+{
+	if (num == 0) { return; }
+	revision++;
+	resetIndex();
+	bool sorted = intervals.empty() || intervals.back().in <= in[0];
+	size_t first = intervals.size();
+	intervals.resize(first + num);
+	Interval *dst = intervals.data() + first;
+	for (size_t i = 0; i < num; i++)
 	{
-		laffected--;
-		if (laffected->second.out > interval.out) 
-		{
-			shortened = laffected->second;
-			shortened.in = interval.in;
-		}
-		laffected++;
+		dst[i].in = in[i];
+		dst[i].out = out[i];
+		dst[i].intensity = intensity[i];
+		intervalsLength += out[i] - in[i];
+		min = std::min(min, intensity[i]);
+		max = std::max(max, intensity[i]);
 	}
-	container.erase(faffected, laffected);
-	if (shortened.length() != 0)
+	if (!sorted)
 	{
-		container[shortened.in] = shortened;
+		std::stable_sort(intervals.begin(), intervals.end(), 
+			[](const Interval &a, const Interval &b) { return a.in < b.in; });
 	}
 }
 
+std::vector<std::string> Feature::getIntervalsIntensity() const
+{
+	std::lock_guard<std::mutex> lock(indexMutex);
+	buildIndex();
+	std::vector<std::string> res;
+	for (const auto &p: index->buckets) { res.push_back(std::to_string((int)p.first)); }
+	return res;
+}
 
+FeatureList::~FeatureList()
+{
+	for (Feature *feature: *this)
+	{
+		delete feature;
+	}
+}
+
+Feature *FeatureList::find(const std::string &name) const
+{
+	for (Feature *feature: *this)
+	{
+		if (feature->getName() == name) { return feature; }
+	}
+	return nullptr;
 }
 
+//rule is one or two bulk operations on sets the feature keeps
+void FeatureList::modifyIntervals(IntervalSet &container, bool add, const Feature *f, 
+	int8_t minIntensity, int8_t maxIntensity, bool affectUnmarked, frame_id wholeDuration)
+{
+	if (add)
+	{
+		container.unite(f->getIntervalsUnion(minIntensity, maxIntensity));
+		if (affectUnmarked) { container.unite(f->getUnmarked(wholeDuration)); }
+	}
+	else if (!container.empty())
+	{
+		container.subtract(f->getIntervalsUnion(minIntensity, maxIntensity));
+		if (affectUnmarked) { container.subtract(f->getUnmarked(wholeDuration)); }
+	}
+}
+
+}
@@ -7,8 +7,9 @@
 #include <map>
 #include <set>
 #include <list>
+#include <cstdint>
+#include <mutex>
 #include <math.h>
-#include <vlc_common.h>
 
 namespace Ntff {
 
@@ -26,19 +27,37 @@ struct Interval
 	int8_t intensity;
 };
 
+class IntervalSet;
+
 class Feature
 {
 public:
 	Feature(const std::string &name, const std::string &description, 
 		const std::string &recAction, const std::string &recEq, int8_t recIntensity);
+	~Feature();
+	Feature(const Feature &) = delete;
+	Feature &operator=(const Feature &) = delete;
 	void appendInterval(const Interval &interval);
+	void appendIntervals(const frame_id *in, const frame_id *out, const int8_t *intensity, size_t num);
+	void setIntervals(const std::vector<Interval> &value);
 	const std::vector<Interval> &getIntervals() const { return intervals; }
+	frame_id getIntervalsLength() const { return intervalsLength; } //sum of lengths, overlaps counted twice
+	unsigned getRevision() const { return revision; } //changes with intervals
 	const std::string &getName() const { return name; }
 	const std::string &getDescription() const { return description; }
 	const std::string &getAction() const { return recAction; }
 	const std::string &getEq() const { return recEq; }
 	int8_t getRecIntensity() const { return recIntensity; }
 	std::vector<std::string> getIntervalsIntensity() const;
+	//merged intervals with intensity in [min, max] (none if min > max), kept until intervals change: the reference is
+	//freed by setIntervals/appendInterval, callers hold Player::featuresMutex while they use it
+	const IntervalSet &getIntervalsUnion(int8_t minIntensity, int8_t maxIntensity) const;
+	//frames without intervals, kept and freed the same way, under Player::featuresMutex
+	const IntervalSet &getUnmarked(frame_id wholeDuration) const;
+	//length of frames of the set by the highest and by the lowest intensity marking them
+	void getIntensityLengths(const IntervalSet &frames, std::map<int8_t, frame_id> &byHighest,
+		std::map<int8_t, frame_id> &byLowest) const;
+	void prepareIndex(frame_id wholeDuration) const; //unmarked frames and layers, ahead of first selection
 	void setRecommended(int8_t intensity, const std::string &action, const std::string &eq)
 	{
 		recIntensity = intensity;
@@ -54,14 +73,24 @@ private:
 	int8_t min;
 	int8_t max;
 	std::vector<Interval> intervals;
+	frame_id intervalsLength;
+	unsigned revision;
+	struct IntensityIndex;
+	mutable IntensityIndex *index; //built on first query
+	mutable std::mutex indexMutex;
+
+	void resetIndex();
+	void buildIndex() const; //under indexMutex
+	void buildLayers() const; //under indexMutex
 };
 
 class FeatureList: public std::vector<Feature *>
 {
 public:
 	~FeatureList();
-	static void insertInterval(std::map<frame_id, Interval> &container, const Interval& interval);
-	static void removeInterval(std::map<frame_id, Interval> &container, const Interval& interval);
+	static void modifyIntervals(IntervalSet &container, bool add, const Feature *f,
+		int8_t minIntensity, int8_t maxIntensity, bool affectUnmarked, frame_id wholeDuration);
+	Feature *find(const std::string &name) const;
 };
 
 }
@@ -0,0 +1,369 @@
+#include "ntff_filter.h"
+#include "ntff_selection.h"
+#include <limits>
+#include <algorithm>
+#include <cstring>
+#include <cctype>
+#include <cstdlib>
+
+namespace Ntff {
+
+static const int8_t anyMin = std::numeric_limits<int8_t>::min();
+static const int8_t anyMax = std::numeric_limits<int8_t>::max();
+static const size_t tableTermsMax = 16;
+
+/* Recursive descent over the text, or binds weaker than and, and than not. */
+class FilterParser
+{
+public:
+	FilterParser(const std::string &text, const FeatureList &features, Filter &filter):
+		text(text), features(features), filter(filter), pos(0) {}
+
+	bool parse(std::string &err)
+	{
+		bool ok = parseOr();
+		skipSpaces();
+		if (ok && pos < text.size()) { ok = fail("unexpected \"" + text.substr(pos) + "\""); }
+		err = error;
+		return ok;
+	}
+private:
+	const std::string &text;
+	const FeatureList &features;
+	Filter &filter;
+	size_t pos;
+	std::string error;
+
+	bool fail(const std::string &message)
+	{
+		error = message;
+		return false;
+	}
+	void skipSpaces()
+	{
+		while (pos < text.size() && isspace((unsigned char)text[pos])) { pos++; }
+	}
+	bool startsWith(const char *str) const { return text.compare(pos, strlen(str), str) == 0; }
+	bool isWordChar() const
+	{
+		if (pos >= text.size() || isspace((unsigned char)text[pos])) { return false; }
+		if (strchr("()!&|<>=\"", text[pos])) { return false; }
+		return !startsWith("≤") && !startsWith("≥");
+	}
+	std::string peekWord() const
+	{
+		size_t end = pos;
+		while (end < text.size() && !isspace((unsigned char)text[end]) && !strchr("()!&|<>=\"", text[end])) { end++; }
+		return text.substr(pos, end - pos);
+	}
+	bool acceptKeyword(const char *keyword, const char *symbol)
+	{
+		skipSpaces();
+		if (startsWith(symbol))
+		{
+			pos += strlen(symbol);
+			if (startsWith(symbol)) { pos += strlen(symbol); } //&& and ||
+			return true;
+		}
+		if (peekWord() == keyword)
+		{
+			pos += strlen(keyword);
+			return true;
+		}
+		return false;
+	}
+	bool parseOr()
+	{
+		if (!parseAnd()) { return false; }
+		while (acceptKeyword("or", "|"))
+		{
+			if (!parseAnd()) { return false; }
+			filter.push(Filter::Or);
+		}
+		return true;
+	}
+	bool parseAnd()
+	{
+		if (!parseNot()) { return false; }
+		while (acceptKeyword("and", "&"))
+		{
+			if (!parseNot()) { return false; }
+			filter.push(Filter::And);
+		}
+		return true;
+	}
+	bool parseNot()
+	{
+		if (!acceptKeyword("not", "!")) { return parseTerm(); }
+		if (!parseNot()) { return false; }
+		filter.push(Filter::Not);
+		return true;
+	}
+	bool parseName(std::string &name)
+	{
+		skipSpaces();
+		if (pos < text.size() && text[pos] == '"')
+		{
+			size_t end = text.find('"', pos + 1);
+			if (end == std::string::npos) { return fail("unterminated quoted name"); }
+			name = text.substr(pos + 1, end - pos - 1);
+			pos = end + 1;
+			return true;
+		}
+		size_t start = pos;
+		while (isWordChar()) { pos++; }
+		if (pos == start)
+		{
+			return fail(pos < text.size() ? "feature expected at \"" + text.substr(pos) + "\"" :
+				"feature expected at the end");
+		}
+		name = text.substr(start, pos - start);
+		return true;
+	}
+	bool parseFeature(const Feature *&feature)
+	{
+		std::string name;
+		if (!parseName(name)) { return false; }
+		feature = features.find(name);
+		if (!feature) { return fail("unknown feature \"" + name + "\""); }
+		return true;
+	}
+	bool parseTerm()
+	{
+		skipSpaces();
+		if (pos < text.size() && text[pos] == '(')
+		{
+			pos++;
+			if (!parseOr()) { return false; }
+			skipSpaces();
+			if (pos >= text.size() || text[pos] != ')') { return fail("\")\" expected"); }
+			pos++;
+			return true;
+		}
+		std::string word = peekWord();
+		if (word == "all")
+		{
+			pos += word.size();
+			filter.push(Filter::All);
+			return true;
+		}
+		const Feature *feature;
+		if (word == "unmarked")
+		{
+			pos += word.size();
+			if (!parseFeature(feature)) { return false; }
+			filter.pushTerm(Filter::Unmarked, feature, anyMin, anyMax);
+			return true;
+		}
+		if (!parseFeature(feature)) { return false; }
+
+		skipSpaces();
+		size_t start = pos;
+		if (startsWith("≤") || startsWith("≥")) { pos += strlen("≤"); }
+		else { while (pos < text.size() && strchr("<>=", text[pos])) { pos++; } }
+		if (pos == start) //marked with any intensity
+		{
+			filter.pushTerm(Filter::Match, feature, anyMin, anyMax);
+			return true;
+		}
+		Comparison eq;
+		std::string eqStr = text.substr(start, pos - start);
+		if (!SelectionRule::parseComparison(eqStr, eq)) { return fail("unknown comparison \"" + eqStr + "\""); }
+		skipSpaces();
+		const char *begin = text.c_str() + pos;
+		char *end;
+		long intensity = strtol(begin, &end, 10);
+		if (end == begin) { return fail("intensity expected after \"" + eqStr + "\""); }
+		if (intensity < anyMin || intensity > anyMax) { return fail("intensity " + std::to_string(intensity) + " is out of range"); }
+		pos += end - begin;
+		int8_t min, max;
+		if (SelectionRule::getIntensityRange(eq, (int8_t)intensity, min, max))
+		{
+			filter.pushTerm(Filter::Match, feature, min, max);
+		}
+		else //no intensity compares true, nothing is matched
+		{
+			filter.push(Filter::All);
+			filter.push(Filter::Not);
+		}
+		return true;
+	}
+};
+
+bool Filter::parse(const std::string &text, const FeatureList &features, Filter &filter, std::string &error)
+{
+	filter = Filter();
+	FilterParser parser(text, features, filter);
+	if (!parser.parse(error)) { filter = Filter(); return false; }
+	return true;
+}
+
+Filter Filter::fromSelection(const Selection &selection)
+{
+	Filter res;
+	if (selection.getBeginAction()) { res.push(All); }
+	for (const SelectionRule &rule: selection.getRules())
+	{
+		bool first = res.program.empty();
+		if (first && !rule.add) { continue; } //nothing to remove from
+		int8_t min, max;
+		bool marked = rule.getIntensityRange(min, max);
+		if (!marked && !rule.affectUnmarked) { continue; } //changes no frames
+		if (marked) { res.pushTerm(Match, rule.feature, min, max); }
+		if (rule.affectUnmarked)
+		{
+			res.pushTerm(Unmarked, rule.feature, anyMin, anyMax);
+			if (marked) { res.push(Or); }
+		}
+		if (rule.add)
+		{
+			if (!first) { res.push(Or); }
+		}
+		else
+		{
+			res.push(Not);
+			res.push(And);
+		}
+	}
+	return res;
+}
+
+void Filter::pushTerm(OpType type, const Feature *feature, int8_t min, int8_t max)
+{
+	uint32_t id = 0;
+	while (id < terms.size() && !(terms[id].feature == feature && terms[id].min == min && terms[id].max == max)) { id++; }
+	if (id == terms.size()) { terms.push_back(Term{feature, min, max}); }
+	program.push_back(Op{type, id});
+}
+
+//boundaries of every term are merged on the fly, result is found once per boundary
+void Filter::apply(IntervalSet &container, frame_id wholeDuration) const
+{
+	container.clear();
+	if (program.empty()) { return; }
+
+	std::vector<const IntervalSet *> sets;
+	for (const Term &term: terms) { sets.push_back(&term.feature->getIntervalsUnion(term.min, term.max)); }
+
+	//a few terms at most, next boundary is found by a scan over them, cheaper than a heap
+	static const frame_id none = std::numeric_limits<frame_id>::max();
+	std::vector<frame_id> next(sets.size(), none);
+	std::vector<size_t> cursors(sets.size(), 0);
+	std::vector<char> inside(sets.size(), false);
+	for (size_t i = 0; i < sets.size(); i++)
+	{
+		if (!sets[i]->empty()) { next[i] = sets[i]->getIn(0); }
+	}
+
+	std::vector<char> stack;
+	stack.reserve(program.size());
+	auto evaluate = [this, &inside, &stack]()
+	{
+		stack.clear();
+		for (const Op &op: program)
+		{
+			switch (op.type)
+			{
+				case Match: stack.push_back(inside[op.term]); break;
+				case Unmarked: stack.push_back(!inside[op.term]); break;
+				case All: stack.push_back(true); break;
+				case Not: stack.back() = !stack.back(); break;
+				case And: stack[stack.size() - 2] &= stack.back(); stack.pop_back(); break;
+				case Or: stack[stack.size() - 2] |= stack.back(); stack.pop_back(); break;
+			}
+		}
+		return stack.back() != 0;
+	};
+
+	//with a few terms, the program is evaluated beforehand for every state of them
+	bool useTable = terms.size() <= tableTermsMax;
+	std::vector<char> table;
+	uint32_t state = 0; //bit per term, when useTable
+	if (useTable)
+	{
+		table.resize((size_t)1 << terms.size());
+		for (uint32_t mask = 0; mask < table.size(); mask++)
+		{
+			for (size_t id = 0; id < terms.size(); id++) { inside[id] = (mask >> id) & 1; }
+			table[mask] = evaluate();
+		}
+		std::fill(inside.begin(), inside.end(), false);
+	}
+
+	//result is clipped to the timeline, frames before the first boundary are outside of every term
+	frame_id prev = 0;
+	bool selected = useTable ? table[0] : evaluate();
+	while (true)
+	{
+		//boundaries at the same frame go one by one, nothing is appended between them
+		frame_id frame = none; //"all" has no terms
+		size_t id = 0;
+		for (size_t i = 0; i < next.size(); i++) //without branches, the nearest set changes at random
+		{
+			bool nearer = next[i] < frame;
+			frame = nearer ? next[i] : frame;
+			id = nearer ? i : id;
+		}
+		if (frame >= wholeDuration) { break; }
+		if (selected && frame > prev) { container.append(prev, frame); }
+		const IntervalSet &set = *sets[id];
+		if (useTable) { state ^= 1u << id; }
+		if (inside[id])
+		{
+			inside[id] = false;
+			next[id] = (++cursors[id] < set.size()) ? set.getIn(cursors[id]) : none;
+		}
+		else
+		{
+			inside[id] = true;
+			next[id] = set.getOut(cursors[id]);
+		}
+		selected = useTable ? table[state] : evaluate();
+		prev = std::max<frame_id>(frame, 0);
+	}
+	if (selected && prev < wholeDuration) { container.append(prev, wholeDuration); }
+}
+
+static std::string termStr(const Feature *feature)
+{
+	const std::string &name = feature->getName();
+	bool plain = !name.empty() && name != "all" && name != "unmarked" && name != "not" &&
+		name != "and" && name != "or";
+	for (char c: name)
+	{
+		if (isspace((unsigned char)c) || strchr("()!&|<>=\"", c)) { plain = false; }
+	}
+	return plain ? name : "\"" + name + "\"";
+}
+
+std::string Filter::toString() const
+{
+	if (program.empty()) { return "nothing"; }
+	std::vector<std::string> stack;
+	for (const Op &op: program)
+	{
+		const Term &term = terms[op.term];
+		switch (op.type)
+		{
+			case Match:
+				if (term.min == anyMin && term.max == anyMax) { stack.push_back(termStr(term.feature)); }
+				else if (term.min == anyMin) { stack.push_back(termStr(term.feature) + " <= " + std::to_string(term.max)); }
+				else { stack.push_back(termStr(term.feature) + " >= " + std::to_string(term.min)); }
+				break;
+			case Unmarked: stack.push_back("unmarked " + termStr(term.feature)); break;
+			case All: stack.push_back("all"); break;
+			case Not: stack.back() = "not " + stack.back(); break;
+			case And:
+			case Or:
+			{
+				std::string right = stack.back();
+				stack.pop_back();
+				stack.back() = "(" + stack.back() + (op.type == And ? " and " : " or ") + right + ")";
+				break;
+			}
+		}
+	}
+	return stack.back();
+}
+
+}
@@ -0,0 +1,53 @@
+#ifndef NTFF_FILTER_H
+#define NTFF_FILTER_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "ntff_feature.h"
+#include "ntff_intervals.h"
+
+namespace Ntff {
+
+class Selection;
+
+/* Boolean expression over features, e.g. "violence >= 3 and not (language < 2)".
+ * Compiled to a postfix program over terms (union of a feature's intervals with
+ * intensity in a range); applied by one sweep over the boundaries of all terms,
+ * evaluating the program where any term starts or ends. */
+class Filter
+{
+public:
+	Filter() {} //selects nothing
+
+	//<feature> [<comparison> <intensity>], "unmarked" <feature>, "all", combined
+	//with not, and, or (also !, &, |) and parentheses; names with spaces are quoted
+	static bool parse(const std::string &text, const FeatureList &features, Filter &filter, std::string &error);
+	static Filter fromSelection(const Selection &selection); //rows one after another, as one expression
+	void apply(IntervalSet &container, frame_id wholeDuration) const;
+	size_t getTermsNum() const { return terms.size(); }
+	std::string toString() const;
+private:
+	struct Term
+	{
+		const Feature *feature;
+		int8_t min;
+		int8_t max;
+	};
+	enum OpType: uint8_t {Match, Unmarked, All, Not, And, Or};
+	struct Op
+	{
+		OpType type;
+		uint32_t term; //for Match and Unmarked
+	};
+	std::vector<Term> terms; //distinct ones
+	std::vector<Op> program; //postfix, empty when nothing is selected
+
+	friend class FilterParser;
+	void pushTerm(OpType type, const Feature *feature, int8_t min, int8_t max);
+	void push(OpType type) { program.push_back(Op{type, 0}); }
+};
+
+}
+
+#endif // NTFF_FILTER_H
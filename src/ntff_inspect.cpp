@@ -0,0 +1,1153 @@
+#include "ntff_project.h"
+#include "ntff_feature.h"
+#include "ntff_selection.h"
+#include "ntff_xml_libxml.h"
+#include "ntff_xml_fast.h"
+#include "ntff_log.h"
+#include "ntff_timecode.h"
+#include "ntff_watcher.h"
+#include "ntff_sidecar.h"
+#include "ntff_intervals.h"
+#include "ntff_bitmap.h"
+#include "ntff_filter.h"
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <map>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <functional>
+#include <new>
+#include <getopt.h>
+#include <sys/resource.h>
+
+using namespace Ntff;
+
+//counts heap allocations to check parser does not allocate per node (-a)
+static std::atomic<size_t> allocationsNum(0);
+static std::atomic<size_t> allocatedBytes(0);
+
+void *operator new(size_t size)
+{
+	allocationsNum.fetch_add(1, std::memory_order_relaxed);
+	allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+	void *res = malloc(size ? size : 1);
+	if (!res) { throw std::bad_alloc(); }
+	return res;
+}
+
+void operator delete(void *ptr) noexcept { free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { free(ptr); }
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"usage: %s [options] <project.kdenlive>\n"
+		"       %s -T <iterations>\n"
+		"       %s -F <operations>\n"
+		"       %s -X <file.kdenlive>...\n"
+		"Loads kdenlive project without VLC and prints load timings, entries, features\n"
+		"and play intervals resulting from the selection.\n"
+		"\n"
+		"  -n <runs>        load the project <runs> times, report min and average time\n"
+		"  -b <add|remove>  action applied to everything before rules (default: remove)\n"
+		"  -r <rule>        <feature>,<add|remove>,<comparison>,<intensity>[,unmarked]\n"
+		"                   may be repeated; recommended settings of every feature otherwise\n"
+		"  -C               do not read or write .ntffc project cache\n"
+		"  -a               report heap allocations made while loading\n"
+		"  -q               do not list play intervals\n"
+		"  -v               print debug log\n"
+		"  -w               keep watching the project, print what changes on every save\n"
+		"  -L               parse with libxml2 only, without fast tokenizer\n"
+		"  -S <file>        write features of the project (with the ones of its sidecar) to sidecar <file>\n"
+		"  -e <expression>  play intervals from filter expression instead of rules, e.g. \"a >= 3 and not b\"\n"
+		"  -I               apply selection with every engine and std::map of intervals, compare result and time\n"
+		"  -T <iterations>  compare timecode parser with MLT formula on random values\n"
+		"  -F <operations>  check interval set and bitmap against frame model on random operations,\n"
+		"                   then benchmark them with std::map at 1e3, 1e5 and 1e6 intervals\n"
+		"  -X               compare nodes of fast tokenizer with libxml2 on the files\n", name, name, name, name);
+}
+
+static void printLog(void *data, Log::Level level, const char *message)
+{
+	bool verbose = *(bool *)data;
+	if (level == Log::Debug && !verbose) { return; }
+
+	const char *prefix = (level == Log::Error) ? "error" : (level == Log::Warning) ? "warning" : "debug";
+	fprintf(stderr, "%s: %s\n", prefix, message);
+}
+
+//time_clock_to_frames of MLT (mlt_property.c), reference for FrameRate::parseTime
+static frame_id mltTimeToFrames(const char *time, double fps)
+{
+	if (!strchr(time, ':')) { return strtol(time, NULL, 0); }
+
+	char copy[64];
+	snprintf(copy, sizeof(copy), "%s", time);
+	int hours = 0, minutes = 0;
+	char *pos = strrchr(copy, ':');
+	double seconds = strtod(pos + 1, NULL);
+	*pos = 0;
+	pos = strrchr(copy, ':');
+	if (pos)
+	{
+		minutes = atoi(pos + 1);
+		*pos = 0;
+		hours = atoi(copy);
+	}
+	else { minutes = atoi(copy); }
+	return floor(fps * hours * 3600) + floor(fps * minutes * 60) + lrint(fps * seconds);
+}
+
+static int checkTimecodes(long iterations)
+{
+	static const FrameRate commonRates[] = {{24, 1}, {25, 1}, {30, 1}, {50, 1}, {60, 1},
+		{24000, 1001}, {30000, 1001}, {60000, 1001}};
+	std::mt19937_64 random(iterations);
+	auto uniform = [&random](long from, long to) { return std::uniform_int_distribution<long>(from, to)(random); };
+
+	std::vector<std::string> times;
+	std::vector<FrameRate> rates;
+	long mismatches = 0;
+	for (long i = 0; i < iterations; i++)
+	{
+		FrameRate rate = (i % 4) ? commonRates[i % 8] : FrameRate(uniform(1, 240000), uniform(1, 1001));
+		char time[64];
+		if (i % 2)
+		{
+			//the way kdenlive stores positions: %02d:%02d:%06.3f of frame start
+			double seconds = uniform(0, rate.num * 36000L / rate.den) / rate.toDouble();
+			long whole = seconds;
+			snprintf(time, sizeof(time), "%02ld:%02ld:%06.3f", whole / 3600, whole / 60 % 60,
+				seconds - whole / 60 * 60);
+		}
+		else
+		{
+			int digits = uniform(0, 6);
+			int len = snprintf(time, sizeof(time), "%ld:%ld:%ld", uniform(0, 99), uniform(0, 59), uniform(0, 59));
+			if (digits > 0) { len += snprintf(time + len, sizeof(time) - len, "."); }
+			for (int d = 0; d < digits; d++) { time[len++] = '0' + uniform(0, 9); }
+			time[len] = 0;
+		}
+
+		frame_id res = rate.parseTime(time);
+		frame_id expected = mltTimeToFrames(time, rate.toDouble());
+		if (res != expected && mismatches++ < 10)
+		{
+			printf("mismatch: %s at %d/%d fps: %ld, expected %ld\n", time, rate.num, rate.den, res, expected);
+		}
+		if (times.size() < 100000)
+		{
+			times.push_back(time);
+			rates.push_back(rate);
+		}
+	}
+
+	using Clock = std::chrono::steady_clock;
+	frame_id sum = 0;
+	Clock::time_point start = Clock::now();
+	for (size_t i = 0; i < times.size(); i++) { sum += rates[i].parseTime(times[i].c_str()); }
+	double parseTime = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+	start = Clock::now();
+	for (size_t i = 0; i < times.size(); i++) { sum -= mltTimeToFrames(times[i].c_str(), rates[i].toDouble()); }
+	double mltTime = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+	printf("timecodes: %ld, mismatches: %ld\n", iterations, mismatches);
+	printf("parse: %.1f ns, MLT formula: %.1f ns per value (checksum %ld)\n", parseTime / times.size(),
+		mltTime / times.size(), sum);
+	return mismatches ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static std::string formatFrames(frame_id frames, double fps)
+{
+	if (fps <= 0) { return "-"; }
+	long seconds = frames / fps;
+	char res[32];
+	snprintf(res, sizeof(res), "%ld:%02ld:%02ld.%02ld", seconds / 3600, seconds / 60 % 60, seconds % 60,
+		(long)(frames - (frame_id)round(seconds * fps)));
+	return res;
+}
+
+static XmlReader *createReader(const std::string &file, bool genericReader)
+{
+	if (genericReader) { return LibXmlReader::create(file); }
+	return FastXmlReader::create(file, [file]() { return LibXmlReader::create(file); });
+}
+
+//allocations of reading every node, attribute and text of the file, as the parser does (-a)
+static size_t countReaderAllocations(const std::string &file, bool genericReader, size_t &nodes)
+{
+	XmlReader *reader = createReader(file, genericReader);
+	if (!reader) { return 0; }
+	size_t before = allocationsNum;
+	const char *value;
+	int type;
+	while ((type = reader->nextNode(&value)) > XmlReader::None)
+	{
+		if (type == XmlReader::StartElem) { while (reader->nextAttr(&value)) {} }
+	}
+	size_t res = allocationsNum - before;
+	nodes = reader->getNodesNum();
+	delete reader;
+	return res;
+}
+
+static bool compareNodes(XmlReader *reader, XmlReader *expected, size_t &nodes, std::string &error)
+{
+	char buffer[256];
+	for (nodes = 0; ; nodes++)
+	{
+		const char *value = nullptr, *expectedValue = nullptr;
+		int type = reader->nextNode(&value);
+		int expectedType = expected->nextNode(&expectedValue);
+		if (expectedType == XmlReader::Error && type != XmlReader::Error)
+		{
+			//libxml2 reads ahead and may fail earlier on malformed file, then fast one must fail too
+			while ((type = reader->nextNode(&value)) > XmlReader::None) {}
+		}
+		if (type != expectedType)
+		{
+			snprintf(buffer, sizeof(buffer), "node %zu: type %d, expected %d", nodes, type, expectedType);
+			error = buffer;
+			return false;
+		}
+		if (type <= XmlReader::None) { return true; }
+		if (strcmp(value, expectedValue) != 0)
+		{
+			snprintf(buffer, sizeof(buffer), "node %zu: \"%.64s\", expected \"%.64s\"", nodes, value, expectedValue);
+			error = buffer;
+			return false;
+		}
+		if (type != XmlReader::StartElem) { continue; }
+
+		//generic reader tells if element is empty only before attributes are read
+		if (reader->isEmptyElement() != expected->isEmptyElement())
+		{
+			snprintf(buffer, sizeof(buffer), "node %zu (%.64s): empty element differs", nodes, value);
+			error = buffer;
+			return false;
+		}
+		const char *attr, *expectedAttr;
+		do
+		{
+			const char *attrValue = nullptr, *expectedAttrValue = nullptr;
+			attr = reader->nextAttr(&attrValue);
+			expectedAttr = expected->nextAttr(&expectedAttrValue);
+			if (!attr != !expectedAttr || (attr && (strcmp(attr, expectedAttr) != 0 ||
+				strcmp(attrValue, expectedAttrValue) != 0)))
+			{
+				snprintf(buffer, sizeof(buffer), "node %zu: attribute %.32s=\"%.64s\", expected %.32s=\"%.64s\"",
+					nodes, attr ? attr : "(none)", attr ? attrValue : "", expectedAttr ? expectedAttr : "(none)",
+					expectedAttr ? expectedAttrValue : "");
+				error = buffer;
+				return false;
+			}
+		}
+		while (attr);
+	}
+}
+
+//fast tokenizer against libxml2 on every file, with every SIMD level CPU has (-X)
+static int compareReaders(char **files, int filesNum)
+{
+	bool ok = filesNum > 0;
+	for (int i = 0; i < filesNum; i++)
+	{
+		std::string file = files[i];
+		for (int simd = FastXmlReader::Scalar; simd <= FastXmlReader::getBestSimd(); simd++)
+		{
+			FastXmlReader::setSimd((FastXmlReader::Simd)simd);
+			XmlReader *expected = LibXmlReader::create(file);
+			XmlReader *reader = createReader(file, false);
+			if (!expected || !reader)
+			{
+				printf("%s: unable to read\n", file.c_str());
+				delete expected;
+				delete reader;
+				ok = false;
+				break;
+			}
+
+			size_t nodes;
+			std::string error;
+			bool same = compareNodes(reader, expected, nodes, error);
+			FastXmlReader *fast = dynamic_cast<FastXmlReader *>(reader);
+			printf("%s [%s]: %s, %zu nodes%s\n", file.c_str(), FastXmlReader::simdName((FastXmlReader::Simd)simd),
+				same ? "same" : error.c_str(), nodes, (fast && fast->usesFallback()) ? ", generic reader fallback" : "");
+			ok &= same;
+			delete expected;
+			delete reader;
+		}
+	}
+	FastXmlReader::setSimd(FastXmlReader::getBestSimd());
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//reloads project the way player does when file is saved, until stdin is closed (-w)
+static int watchProject(const std::string &file, bool useCache, bool genericReader)
+{
+	Project project(file, [&file, genericReader]() { return createReader(file, genericReader); }, useCache);
+	if (!project.isValid()) { return EXIT_FAILURE; }
+	delete project.generateFeatureList();
+	if (!project.indexSections()) { printf("sections are not indexed, reload parses whole project\n"); }
+
+	FileWatcher watcher(file, [&project, genericReader]()
+	{
+		using Clock = std::chrono::steady_clock;
+		ProjectUpdate update;
+		Clock::time_point start = Clock::now();
+		bool ok = project.reload([genericReader] (const char *data, size_t size) -> XmlReader *
+		{
+			if (genericReader) { return LibXmlReader::create(data, size); }
+			return FastXmlReader::create(data, size, [data, size]() { return LibXmlReader::create(data, size); });
+		}, update);
+		double time = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		if (!ok) { printf("reload failed (%.3f ms)\n", time); return; }
+
+		printf("reload: %.3f ms%s\n", time, update.mediaChanged ? ", media changed" : "");
+		for (const Feature *feature: update.features)
+		{
+			printf("  %s: %zu intervals\n", feature->getName().c_str(), feature->getIntervals().size());
+		}
+		for (const std::string &name: update.removedFeatures) { printf("  %s: removed\n", name.c_str()); }
+		fflush(stdout);
+	});
+	if (!watcher.isValid()) { return EXIT_FAILURE; }
+
+	printf("watching %s, close stdin to stop\n", file.c_str());
+	fflush(stdout);
+	while (getchar() != EOF) {}
+	return EXIT_SUCCESS;
+}
+
+//play intervals as they were kept before IntervalSet, one std::map node per interval (-I)
+using IntervalMap = std::map<frame_id, Interval>;
+
+static void mapInsertInterval(IntervalMap &container, const Interval &interval)
+{
+	if (container.empty()) { container[interval.in] = interval; return; }
+
+	Interval res = interval;
+	auto faffected = container.lower_bound(interval.in);
+	if (faffected == container.end() ||
+		(faffected->second.in > interval.in && faffected != container.begin())) //maybe need change prev
+	{
+		faffected--;
+		if (faffected->second.out > interval.in) { res.in = faffected->second.in; }
+		res.out = std::max(res.out, faffected->second.out);
+		faffected++;
+	}
+
+	auto laffected = container.lower_bound(interval.out);
+	if (laffected != container.end() && laffected->second.in == interval.out)
+	{
+		res.out = laffected->second.out;
+		laffected++;
+	}
+	else if (laffected != container.begin())
+	{
+		laffected--;
+		res.out = std::max(res.out, laffected->second.out);
+		laffected++;
+	}
+	container.erase(faffected, laffected);
+	container[res.in] = res;
+}
+
+static void mapRemoveInterval(IntervalMap &container, const Interval &interval)
+{
+	if (container.empty()) { return; }
+
+	auto faffected = container.upper_bound(interval.in); //maybe need change .out of prev
+	if (faffected == container.begin()) { return; }
+	faffected--;
+	Interval &fint = faffected->second;
+	bool done = false;
+	if (fint.out > interval.out)
+	{
+		container[interval.out] = Interval(interval.out, fint.out);
+		done = true;
+	}
+	if (fint.out > interval.in) { fint.out = interval.in; }
+	faffected++;
+	if (fint.length() == 0) { container.erase(fint.in); }
+	if (done) { return; }
+
+	auto laffected = container.lower_bound(interval.out);
+	Interval shortened;
+	if (laffected != container.begin()) //maybe need change .in of prev
+	{
+		laffected--;
+		if (laffected->second.out > interval.out)
+		{
+			shortened = laffected->second;
+			shortened.in = interval.in;
+		}
+		laffected++;
+	}
+	container.erase(faffected, laffected);
+	if (shortened.length() != 0) { container[shortened.in] = shortened; }
+}
+
+static void mapApplySelection(const Selection &selection, IntervalMap &container, frame_id wholeDuration)
+{
+	container.clear();
+	if (selection.getBeginAction()) { container[0] = Interval(0, wholeDuration); }
+	for (const SelectionRule &rule: selection.getRules())
+	{
+		auto modify = rule.add ? &mapInsertInterval : &mapRemoveInterval;
+		int8_t min, max;
+		rule.getIntensityRange(min, max);
+		const std::vector<Interval> &featureIntervals = rule.feature->getIntervals();
+		for (const Interval &interval: featureIntervals)
+		{
+			if (interval.intensity >= min && interval.intensity <= max) { modify(container, interval); }
+		}
+		if (rule.affectUnmarked)
+		{
+			frame_id prevOut = 0;
+			for (const Interval &interval: featureIntervals)
+			{
+				if (interval.in > prevOut) { modify(container, Interval(prevOut, interval.in)); }
+				prevOut = std::max(prevOut, interval.out);
+			}
+			if (wholeDuration > prevOut) { modify(container, Interval(prevOut, wholeDuration)); }
+		}
+	}
+}
+
+static size_t countMismatches(const char *name, const IntervalSet &res, const IntervalSet &expected)
+{
+	size_t mismatches = 0;
+	for (size_t i = 0; i < std::max(res.size(), expected.size()); i++)
+	{
+		Interval a = (i < res.size()) ? res[i] : Interval();
+		Interval b = (i < expected.size()) ? expected[i] : Interval();
+		if ((a.in != b.in || a.out != b.out) && mismatches++ < 10)
+		{
+			printf("mismatch at %zu: %s %ld - %ld, interval set %ld - %ld\n", i, name, a.in, a.out, b.in, b.out);
+		}
+	}
+	return mismatches;
+}
+
+//stream frames from cumulative lengths against a scan from the beginning, as the player did
+static size_t checkStreamMapping(const IntervalSet &set, frame_id wholeDuration)
+{
+	std::mt19937_64 random(set.size());
+	size_t mismatches = 0;
+	for (int i = 0; i < 1000 && wholeDuration > 0; i++)
+	{
+		frame_id frame = std::uniform_int_distribution<frame_id>(0, wholeDuration)(random);
+		frame_id expected = 0;
+		for (size_t id = 0; id < set.size() && set.getIn(id) < frame; id++)
+		{
+			expected += std::min(frame, set.getOut(id)) - set.getIn(id);
+		}
+		frame_id res = set.toStream(frame);
+		size_t id = set.findByStream(res);
+		bool backOk = id < set.size() ? (set.lengthBefore(id) <= res && res <= set.lengthBefore(id + 1)) : res == set.length();
+		if ((res != expected || !backOk) && mismatches++ < 10)
+		{
+			printf("stream mismatch at frame %ld: %ld, expected %ld, interval %zu\n", frame, res, expected, id);
+		}
+	}
+	return mismatches;
+}
+
+//user drags intensity of every rule in turn through all values, as in dialog
+static size_t checkSelectionCache(const Selection &selection, frame_id wholeDuration)
+{
+	using Clock = std::chrono::steady_clock;
+	SelectionCache cache;
+	IntervalSet res;
+	cache.apply(selection, res, wholeDuration);
+	double cachedTime = 0, fullTime = 0;
+	size_t mismatches = 0, applies = 0, reused = 0;
+	for (size_t row = 0; row < selection.getRules().size(); row++)
+	{
+		for (int8_t intensity = 0; intensity <= 10; intensity++)
+		{
+			Selection changed;
+			changed.setBeginAction(selection.getBeginAction());
+			for (size_t i = 0; i < selection.getRules().size(); i++)
+			{
+				SelectionRule rule = selection.getRules()[i];
+				if (i == row) { rule.intensity = intensity; }
+				changed.append(rule);
+			}
+			Clock::time_point start = Clock::now();
+			cache.apply(changed, res, wholeDuration);
+			cachedTime += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+			reused += cache.getReusedNum();
+
+			IntervalSet expected;
+			start = Clock::now();
+			changed.apply(expected, wholeDuration, Selection::Intervals);
+			fullTime += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+			mismatches += countMismatches("cache", res, expected);
+			applies++;
+		}
+	}
+	if (applies)
+	{
+		printf("selection cache: %zu changes, %.3f ms each (full %.3f ms), %.1f rules reused, mismatches: %zu\n",
+			applies, cachedTime / applies, fullTime / applies, (double)reused / applies, mismatches);
+	}
+	return mismatches;
+}
+
+//length shown next to every value of dialog rows against the selection applied with the value,
+//comparison is picked at random for each value
+static size_t checkSelectionLengths(const Selection &selection, frame_id wholeDuration)
+{
+	using Clock = std::chrono::steady_clock;
+	std::mt19937_64 random(selection.getRules().size());
+	SelectionCache cache;
+	SelectionLengths lengths;
+	IntervalSet res;
+	cache.apply(selection, res, wholeDuration);
+	//player prepares features in background after load
+	Clock::time_point start = Clock::now();
+	for (const SelectionRule &rule: selection.getRules()) { rule.feature->prepareIndex(wholeDuration); }
+	double prepareTime = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	start = Clock::now();
+	lengths.update(selection, cache, wholeDuration);
+	double updateTime = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+	size_t mismatches = 0, values = 0;
+	const std::vector<SelectionRule> &rules = selection.getRules();
+	for (size_t row = 0; row < rules.size(); row++)
+	{
+		for (const std::string &value: rules[row].feature->getIntervalsIntensity())
+		{
+			SelectionRule rule = rules[row];
+			rule.eq = (Comparison)std::uniform_int_distribution<int>(Less, MoreOrEq)(random);
+			rule.intensity = atoi(value.c_str());
+			Selection changed;
+			changed.setBeginAction(selection.getBeginAction());
+			for (size_t i = 0; i < rules.size(); i++) { changed.append(i == row ? rule : rules[i]); }
+			changed.apply(res, wholeDuration);
+			frame_id length = lengths.get(row, rule.eq, rule.intensity);
+			if (length != res.length() && mismatches++ < 10)
+			{
+				printf("length mismatch at rule %zu %s %d: %ld, applied %ld\n", row,
+					SelectionRule::comparisonStr(rule.eq), rule.intensity, length, res.length());
+			}
+			values++;
+		}
+	}
+	printf("value lengths: %zu rules, update %.3f ms (features prepared %.3f ms), %zu values checked, "
+		"mismatches: %zu\n", rules.size(), updateTime, prepareTime, values, mismatches);
+	return mismatches;
+}
+
+//expected is the result of selection applied by the engine chosen for it
+static int compareIntervalSets(const Selection &selection, const IntervalSet &expected, frame_id wholeDuration,
+	double expectedTime)
+{
+	using Clock = std::chrono::steady_clock;
+	printf("selection engine: %s\n", selection.isDense() ? "bitmap" : "intervals");
+	size_t mismatches = 0;
+	static const Selection::Engine engines[] = {Selection::Intervals, Selection::Bitmap};
+	static const char *engineNames[] = {"intervals", "bitmap"};
+	for (int e = 0; e < 2; e++)
+	{
+		IntervalSet res;
+		Clock::time_point start = Clock::now();
+		selection.apply(res, wholeDuration, engines[e]);
+		double time = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		size_t engineMismatches = countMismatches(engineNames[e], res, expected);
+		printf("%s: %zu intervals, selection: %.3f ms, mismatches: %zu\n", engineNames[e], res.size(), time,
+			engineMismatches);
+		mismatches += engineMismatches;
+	}
+
+	//rows as one expression, sweep keeps frames of the timeline only
+	Filter filter = Filter::fromSelection(selection);
+	IntervalSet res, clipped = expected;
+	clipped.subtract(IntervalSet(Interval(wholeDuration, std::numeric_limits<frame_id>::max())));
+	Clock::time_point sweepStart = Clock::now();
+	filter.apply(res, wholeDuration);
+	double sweepTime = std::chrono::duration<double, std::milli>(Clock::now() - sweepStart).count();
+	size_t sweepMismatches = countMismatches("sweep", res, clipped);
+	printf("sweep: %zu terms, %zu intervals, selection: %.3f ms, mismatches: %zu\n", filter.getTermsNum(),
+		res.size(), sweepTime, sweepMismatches);
+	mismatches += sweepMismatches;
+
+	IntervalMap container;
+	Clock::time_point start = Clock::now();
+	mapApplySelection(selection, container, wholeDuration);
+	double time = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+	//map keeps touching intervals apart, when one was added on the left of the other
+	IntervalSet merged;
+	for (const auto &p: container) { merged.append(p.second.in, p.second.out); }
+	size_t streamMismatches = checkStreamMapping(expected, wholeDuration);
+	printf("stream frames: mismatches: %zu\n", streamMismatches);
+	mismatches += streamMismatches;
+	mismatches += checkSelectionCache(selection, wholeDuration);
+	mismatches += checkSelectionLengths(selection, wholeDuration);
+	printf("std::map: %zu intervals, selection: %.3f ms (selected engine %.3f ms), mismatches: %zu"
+		" (reference, removal could drop more than asked)\n", container.size(), time, expectedTime,
+		countMismatches("map", merged, expected));
+	return mismatches ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+//frames of a window are kept one by one, the trivially correct model of interval sets (-F)
+class FrameModel
+{
+public:
+	FrameModel(frame_id base, frame_id size): base(base), frames(size, 0) {}
+	frame_id getBase() const { return base; }
+	frame_id getEnd() const { return base + frames.size(); }
+	bool contains(frame_id frame) const { return frame >= base && frame < getEnd() && frames[frame - base]; }
+	void set(const IntervalSet &set, bool value)
+	{
+		for (size_t i = 0; i < set.size(); i++)
+		{
+			for (frame_id frame = set.getIn(i); frame < set.getOut(i); frame++) { frames[frame - base] = value; }
+		}
+	}
+	frame_id countBefore(frame_id frame) const
+	{
+		frame_id res = 0;
+		for (frame_id f = base; f < frame; f++) { res += frames[f - base]; }
+		return res;
+	}
+	//intervals of the set cover exactly the frames of model
+	bool matches(const IntervalSet &set) const
+	{
+		frame_id pos = base;
+		for (size_t i = 0; i < set.size(); i++)
+		{
+			if (set.getIn(i) < pos || set.getIn(i) >= set.getOut(i) || set.getOut(i) > getEnd()) { return false; }
+			for (; pos < set.getIn(i); pos++) { if (frames[pos - base]) { return false; } }
+			for (; pos < set.getOut(i); pos++) { if (!frames[pos - base]) { return false; } }
+		}
+		for (; pos < getEnd(); pos++) { if (frames[pos - base]) { return false; } }
+		return true;
+	}
+private:
+	frame_id base;
+	std::vector<uint8_t> frames;
+};
+
+template<class Random> static std::vector<Interval> randomIntervals(Random &random, frame_id from, frame_id to)
+{
+	auto uniform = [&random](frame_id a, frame_id b) { return std::uniform_int_distribution<frame_id>(a, b)(random); };
+	std::vector<Interval> res;
+	frame_id maxLength = uniform(0, 3) ? uniform(1, 16) : uniform(1, to - from); //short and touching, or long ones
+	frame_id maxGap = uniform(0, 2) ? uniform(0, 16) : uniform(0, to - from);
+	for (frame_id pos = from + uniform(0, maxGap); pos < to;)
+	{
+		frame_id length = uniform(1, maxLength);
+		int8_t intensity = uniform(0, 30) ? uniform(0, 9) : uniform(0, 1) ? -128 : 127; //extremes rarely
+		res.push_back(Interval(pos, std::min(to, pos + length), intensity));
+		pos += uniform(0, 4) ? length + uniform(0, maxGap) : uniform(0, length); //overlapping sometimes
+	}
+	return res;
+}
+
+static bool sameSets(const IntervalSet &a, const IntervalSet &b)
+{
+	if (a.size() != b.size()) { return false; }
+	for (size_t i = 0; i < a.size(); i++)
+	{
+		if (a.getIn(i) != b.getIn(i) || a.getOut(i) != b.getOut(i)) { return false; }
+	}
+	return true;
+}
+
+//random filter expressions and selections on random features against frames evaluated one by one,
+//lengths of every value of selection rules against selections applied with them; features go past
+//the end of the timeline, filter keeps frames of the timeline only
+template<class Random> static long checkFilters(Random &random, long iterations)
+{
+	auto uniform = [&random](frame_id a, frame_id b) { return std::uniform_int_distribution<frame_id>(a, b)(random); };
+	long mismatches = 0;
+	auto report = [&mismatches](const std::string &text, const std::string &error)
+	{
+		if (mismatches++ < 10) { printf("filter mismatch: \"%s\"%s%s\n", text.c_str(), error.empty() ? "" : ": ", error.c_str()); }
+	};
+	for (long iteration = 0; iteration < iterations; iteration += 8)
+	{
+		frame_id duration = uniform(1, 400);
+		FeatureList features;
+		for (const char *name: {"a", "b", "c d"})
+		{
+			Feature *feature = new Feature(name, "", "", "", 0);
+			for (const Interval &interval: randomIntervals(random, 0, duration + 20)) { feature->appendInterval(interval); }
+			features.push_back(feature);
+		}
+		auto intervalsToSet = [duration](const std::vector<char> &frames)
+		{
+			IntervalSet res;
+			for (frame_id frame = 0; frame < duration; frame++)
+			{
+				if (frames[frame]) { res.append(frame, frame + 1); }
+			}
+			return res;
+		};
+		if (iteration == 0)
+		{
+			Filter filter;
+			std::string error;
+			for (const char *text: {"", "a and", "(a or b", "e", "a >= x", "a => 2", "a < 300", "\"c d", "a b"})
+			{
+				if (Filter::parse(text, features, filter, error)) { report(text, "parsed"); }
+			}
+
+			//nothing is below the lowest intensity or above the highest one
+			IntervalSet res;
+			for (const char *text: {"a < -128", "b > 127", "not (a < -128) and (b > 127)"})
+			{
+				if (!Filter::parse(text, features, filter, error)) { report(text, error); continue; }
+				filter.apply(res, duration);
+				if (!res.empty()) { report(text, "selected " + std::to_string(res.length()) + " frames"); }
+			}
+			for (const char *text: {"a,add,<,-128", "b,add,>,127"})
+			{
+				SelectionRule rule;
+				Selection selection;
+				if (!Selection::parseRule(text, features, rule, error)) { report(text, error); continue; }
+				selection.append(rule);
+				SelectionCache cache;
+				SelectionLengths lengths;
+				cache.apply(selection, res, duration);
+				lengths.update(selection, cache, duration);
+				frame_id length = res.length() + lengths.get(0, rule.eq, rule.intensity);
+				selection.apply(res, duration, Selection::Intervals);
+				length += res.length();
+				selection.apply(res, duration, Selection::Bitmap);
+				length += res.length();
+				Filter::fromSelection(selection).apply(res, duration);
+				length += res.length();
+				if (length) { report(text, "selected " + std::to_string(length) + " frames"); }
+			}
+		}
+
+		std::function<std::string(int, std::vector<char> &)> generate = [&](int depth, std::vector<char> &frames)
+		{
+			frames.assign(duration, 0);
+			int kind = uniform(0, depth ? 5 : 1);
+			if (kind < 2)
+			{
+				const Feature *feature = features[uniform(0, 2)];
+				std::string name = (feature->getName() == "c d") ? "\"c d\"" : feature->getName();
+				int8_t min = std::numeric_limits<int8_t>::min(), max = std::numeric_limits<int8_t>::max();
+				std::string text = name;
+				int form = uniform(0, 6);
+				if (form == 5) { text = "unmarked " + name; }
+				else if (form == 6) { text = "all"; }
+				else if (form > 0)
+				{
+					static const char *eqs[] = {"<", ">", "<=", ">="};
+					static const char *altEqs[] = {"<", ">", "≤", "≥"};
+					int intensity = uniform(0, 10) ? uniform(-1, 10) : uniform(0, 1) ? -128 : 127;
+					SelectionRule::getIntensityRange((Comparison)(form - 1), intensity, min, max);
+					text += std::string(uniform(0, 1) ? " " : "") + (uniform(0, 1) ? eqs : altEqs)[form - 1] +
+						" " + std::to_string(intensity);
+				}
+				for (const Interval &interval: feature->getIntervals())
+				{
+					if (form == 5 || (interval.intensity >= min && interval.intensity <= max))
+					{
+						for (frame_id f = interval.in; f < std::min(interval.out, duration); f++) { frames[f] = 1; }
+					}
+				}
+				if (form >= 5)
+				{
+					for (char &frame: frames) { frame = (form == 6) ? 1 : !frame; }
+				}
+				return text;
+			}
+			std::vector<char> left, right;
+			std::string text = "(" + generate(depth - 1, left) + ")";
+			if (kind == 2)
+			{
+				for (frame_id f = 0; f < duration; f++) { frames[f] = !left[f]; }
+				return (uniform(0, 1) ? "not " : "!") + text;
+			}
+			text += (kind == 3) ? (uniform(0, 1) ? " and " : " && ") : (uniform(0, 1) ? " or " : "|");
+			text += "(" + generate(depth - 1, right) + ")";
+			for (frame_id f = 0; f < duration; f++) { frames[f] = (kind == 3) ? left[f] && right[f] : left[f] || right[f]; }
+			return text;
+		};
+		for (int step = 0; step < 8; step++)
+		{
+			std::vector<char> frames;
+			std::string text = generate(uniform(0, 4), frames);
+			Filter filter;
+			std::string error;
+			if (!Filter::parse(text, features, filter, error)) { report(text, error); continue; }
+			IntervalSet res;
+			filter.apply(res, duration);
+			if (!sameSets(res, intervalsToSet(frames))) { report(text, ""); }
+
+			//rows of the dialog as one expression give the same as applied one by one
+			Selection selection;
+			selection.setBeginAction(uniform(0, 1));
+			for (int i = uniform(0, 4); i > 0; i--)
+			{
+				SelectionRule rule{features[uniform(0, 2)], uniform(0, 1) != 0, (Comparison)uniform(0, 3),
+					(int8_t)uniform(0, 9), uniform(0, 2) == 0};
+				selection.append(rule);
+			}
+			Filter fromSelection = Filter::fromSelection(selection);
+			IntervalSet expected;
+			selection.apply(expected, duration);
+			expected.subtract(IntervalSet(Interval(duration, duration + 1000))); //frames past the end
+			fromSelection.apply(res, duration);
+			if (!sameSets(res, expected)) { report(fromSelection.toString(), "selection"); }
+
+			//every value of every rule against the selection applied with it
+			SelectionCache cache;
+			SelectionLengths lengths;
+			cache.apply(selection, res, duration);
+			lengths.update(selection, cache, duration);
+			const std::vector<SelectionRule> &rules = selection.getRules();
+			std::vector<int8_t> values{std::numeric_limits<int8_t>::min(), std::numeric_limits<int8_t>::max()};
+			for (int8_t value = -1; value <= 10; value++) { values.push_back(value); }
+			for (size_t i = 0; i < rules.size(); i++)
+			{
+				SelectionRule rule = rules[i];
+				for (int eq = Less; eq <= MoreOrEq; eq++)
+				{
+					rule.eq = (Comparison)eq;
+					for (int8_t value: values)
+					{
+						rule.intensity = value;
+						Selection changed;
+						changed.setBeginAction(selection.getBeginAction());
+						for (size_t j = 0; j < rules.size(); j++) { changed.append(j == i ? rule : rules[j]); }
+						changed.apply(res, duration);
+						if (lengths.get(i, rule.eq, rule.intensity) != res.length())
+						{
+							report(Filter::fromSelection(changed).toString(), "length of rule " + std::to_string(i) +
+								" value " + std::to_string(lengths.get(i, rule.eq, rule.intensity)) +
+								", applied " + std::to_string(res.length()));
+						}
+					}
+				}
+			}
+		}
+	}
+	return mismatches;
+}
+
+//random unions, differences, complements and patches of play intervals are checked against frame
+//model; std::map code intervals were kept in before is the buggy baseline, it is only timed
+static int checkIntervalAlgebra(long iterations)
+{
+	std::mt19937_64 random(iterations);
+	auto uniform = [&random](frame_id a, frame_id b) { return std::uniform_int_distribution<frame_id>(a, b)(random); };
+	long mismatches = 0, bitmapMismatches = 0, operations = 0;
+	auto report = [](long &counter, const char *engine, long operation, const char *name)
+	{
+		if (counter++ < 10) { printf("%s mismatch at operation %ld (%s)\n", engine, operation, name); }
+	};
+
+	while (operations < iterations)
+	{
+		//window crosses a bitmap chunk border every other time
+		frame_id size = uniform(1, 600);
+		frame_id base = uniform(0, 1) ? uniform(0, 3) * 65536 - uniform(0, size) : uniform(0, 1000000);
+		base = std::max<frame_id>(0, base);
+		FrameModel model(base, size);
+		IntervalSet set;
+		FrameBitmap bitmap;
+		for (int step = 0; step < 8 && operations < iterations; step++, operations++)
+		{
+			std::vector<Interval> intervals = randomIntervals(random, base, base + size);
+			int8_t min = uniform(0, 9), max = uniform(min, 9);
+			IntervalSet other = IntervalSet::fromIntervals(intervals, min, max);
+			int kind = uniform(0, 4);
+			if (kind == 4) { other = other.complement(base + size); other.subtract(IntervalSet(Interval(0, base))); }
+			const char *name = "unite";
+			bool add = uniform(0, 1);
+			if (kind == 3 && !set.empty())
+			{
+				//as player keeps current interval apart from selection
+				name = "patch";
+				frame_id in = uniform(base, base + size - 1), out = uniform(in + 1, base + size);
+				set.subtract(IntervalSet(Interval(in, out)));
+				set.insert(Interval(in, out));
+				other = IntervalSet(Interval(in, out));
+				bitmap.unite(FrameBitmap::fromSet(other));
+				add = true;
+			}
+			else if (add)
+			{
+				set.unite(other);
+				bitmap.unite(kind == 2 ? FrameBitmap::fromIntervals(intervals, min, max) : FrameBitmap::fromSet(other));
+			}
+			else
+			{
+				name = "subtract";
+				set.subtract(other);
+				bitmap.subtract(FrameBitmap::fromSet(other));
+			}
+			model.set(other, add);
+
+			frame_id frame = uniform(base, base + size);
+			frame_id before = model.countBefore(frame);
+			frame_id length = model.countBefore(base + size);
+			size_t id = set.findByStream(before);
+			bool streamOk = set.toStream(frame) == before && set.length() == length &&
+				(id == set.size() ? before == length : set.lengthBefore(id) <= before && before <= set.lengthBefore(id + 1));
+			if (!model.matches(set) || !streamOk) { report(mismatches, "interval set", operations, name); }
+			IntervalSet fromBitmap = bitmap.toSet();
+			if (!model.matches(fromBitmap) || bitmap.length() != length || bitmap.contains(frame) != model.contains(frame))
+			{
+				report(bitmapMismatches, "bitmap", operations, name);
+			}
+		}
+	}
+	printf("interval operations: %ld, mismatches: interval set %ld, bitmap %ld\n",
+		operations, mismatches, bitmapMismatches);
+	long filterMismatches = checkFilters(random, iterations);
+	printf("filter expressions: %ld, mismatches: %ld\n", iterations, filterMismatches);
+
+	using Clock = std::chrono::steady_clock;
+	auto generate = [&uniform](frame_id num)
+	{
+		IntervalSet res;
+		for (frame_id i = 0, pos = 0; i < num; i++, pos += uniform(1, 8))
+		{
+			frame_id in = pos;
+			pos += uniform(1, 16);
+			res.append(in, pos);
+		}
+		return res;
+	};
+	for (frame_id num: {1000, 100000, 1000000})
+	{
+		IntervalSet a = generate(num), b = generate(num);
+		double setTime[2], bitmapTime[2], mapTime[2];
+		for (int add = 0; add < 2; add++)
+		{
+			IntervalSet res = a;
+			Clock::time_point start = Clock::now();
+			if (add) { res.unite(b); }
+			else { res.subtract(b); }
+			setTime[add] = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+			FrameBitmap bitmap = FrameBitmap::fromSet(a), bitmapOther = FrameBitmap::fromSet(b);
+			start = Clock::now();
+			if (add) { bitmap.unite(bitmapOther); }
+			else { bitmap.subtract(bitmapOther); }
+			bitmapTime[add] = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+			IntervalMap map;
+			for (size_t i = 0; i < a.size(); i++) { map[a.getIn(i)] = a[i]; }
+			start = Clock::now();
+			for (size_t i = 0; i < b.size(); i++)
+			{
+				if (add) { mapInsertInterval(map, b[i]); }
+				else { mapRemoveInterval(map, b[i]); }
+			}
+			mapTime[add] = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		}
+		printf("%ld intervals: unite %.3f ms (bitmap %.3f, std::map %.3f), subtract %.3f ms (bitmap %.3f, std::map %.3f)\n",
+			(long)a.size(), setTime[1], bitmapTime[1], mapTime[1], setTime[0], bitmapTime[0], mapTime[0]);
+	}
+	return (mismatches || bitmapMismatches || filterMismatches) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+	int runs = 1;
+	bool useCache = true;
+	bool listIntervals = true;
+	bool verbose = false;
+	bool beginAdd = false;
+	bool countAllocations = false;
+	bool watch = false;
+	bool genericReader = false;
+	bool compareXml = false;
+	bool compareIntervals = false;
+	long timecodeIterations = 0;
+	long intervalOperations = 0;
+	std::vector<std::string> ruleArgs;
+	std::string sidecarPath;
+	std::string filterText;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "n:b:r:e:CaqvwLS:XIT:F:h")) != -1)
+	{
+		switch (opt)
+		{
+			case 'n': runs = std::max(1, atoi(optarg)); break;
+			case 'b':
+				if (!Selection::parseAction(optarg, beginAdd))
+				{
+					fprintf(stderr, "unknown action \"%s\"\n", optarg);
+					return EXIT_FAILURE;
+				}
+				break;
+			case 'r': ruleArgs.push_back(optarg); break;
+			case 'e': filterText = optarg; break;
+			case 'C': useCache = false; break;
+			case 'a': countAllocations = true; break;
+			case 'q': listIntervals = false; break;
+			case 'v': verbose = true; break;
+			case 'w': watch = true; break;
+			case 'L': genericReader = true; break;
+			case 'S': sidecarPath = optarg; break;
+			case 'X': compareXml = true; break;
+			case 'I': compareIntervals = true; break;
+			case 'T': timecodeIterations = std::max(1L, atol(optarg)); break;
+			case 'F': intervalOperations = std::max(1L, atol(optarg)); break;
+			default: usage(argv[0]); return (opt == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+	if (timecodeIterations) { return checkTimecodes(timecodeIterations); }
+	if (intervalOperations) { return checkIntervalAlgebra(intervalOperations); }
+	if (compareXml) { return compareReaders(argv + optind, argc - optind); }
+	if (optind + 1 != argc) { usage(argv[0]); return EXIT_FAILURE; }
+
+	std::string file = argv[optind];
+	Log::setHandler(printLog, &verbose);
+
+	using Clock = std::chrono::steady_clock;
+	double minTime = 0, sumTime = 0, featuresTime = 0;
+	FeatureList *features = nullptr;
+	std::vector<MediaEntry> entries;
+	FrameRate frameRate;
+	LoadStats stats;
+	size_t allocations = 0, bytes = 0;
+
+	for (int run = 0; run < runs; run++)
+	{
+		delete features;
+		features = nullptr;
+
+		size_t allocationsBefore = allocationsNum, bytesBefore = allocatedBytes;
+		Clock::time_point start = Clock::now();
+		Project project(file, [&file, genericReader]() { return createReader(file, genericReader); }, useCache);
+		if (!project.isValid())
+		{
+			fprintf(stderr, "%s: unable to load project\n", file.c_str());
+			return EXIT_FAILURE;
+		}
+		entries = project.getMediaEntries();
+		frameRate = project.getFrameRate();
+		stats = project.getStats();
+		double time = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		//player starts here, features are materialized in background
+		start = Clock::now();
+		features = project.generateFeatureList();
+		featuresTime = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		allocations = allocationsNum - allocationsBefore;
+		bytes = allocatedBytes - bytesBefore;
+
+		minTime = (run == 0) ? time : std::min(minTime, time);
+		sumTime += time;
+	}
+
+	frame_id wholeDuration = entries.empty() ? 0 : entries.back().interval.out;
+	printf("project: %s\n", file.c_str());
+	printf("load: min %.3f ms, avg %.3f ms (%d runs), then features: %.3f ms\n", minTime, sumTime / runs,
+		runs, featuresTime);
+	printf("phases: %s\n", stats.toString().c_str());
+	if (countAllocations)
+	{
+		rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+		printf("allocations: %zu (%zu KB), peak rss: %ld KB\n", allocations, bytes / 1024, usage.ru_maxrss);
+		size_t nodes = 0;
+		size_t readerAllocations = countReaderAllocations(file, genericReader, nodes);
+		printf("reader allocations: %zu over %zu nodes, the rest is model objects and path resolution\n", readerAllocations, nodes);
+	}
+	printf("fps: %d/%d (%g)\n", frameRate.num, frameRate.den, frameRate.toDouble());
+	printf("entries: %zu, duration: %ld frames (%s)\n", entries.size(), wholeDuration,
+		formatFrames(wholeDuration, frameRate.toDouble()).c_str());
+	printf("features: %zu\n", features->size());
+	for (const Feature *feature: *features)
+	{
+		printf("  %s: %zu intervals, recommended: %s %s %d\n", feature->getName().c_str(),
+			feature->getIntervals().size(), feature->getAction().c_str(), feature->getEq().c_str(),
+			feature->getRecIntensity());
+	}
+
+	if (!sidecarPath.empty())
+	{
+		FeatureSidecar::Writer writer(frameRate);
+		for (const Feature *feature: *features) { writer.addFeature(*feature); }
+		if (!writer.write(sidecarPath))
+		{
+			fprintf(stderr, "%s: unable to write sidecar\n", sidecarPath.c_str());
+			return EXIT_FAILURE;
+		}
+		printf("sidecar: %s\n", sidecarPath.c_str());
+	}
+
+	Selection selection = ruleArgs.empty() ? Selection::recommended(*features) : Selection();
+	selection.setBeginAction(beginAdd);
+	for (const std::string &arg: ruleArgs)
+	{
+		SelectionRule rule;
+		std::string error;
+		if (!Selection::parseRule(arg, *features, rule, error))
+		{
+			fprintf(stderr, "rule \"%s\": %s\n", arg.c_str(), error.c_str());
+			delete features;
+			return EXIT_FAILURE;
+		}
+		selection.append(rule);
+	}
+
+	printf("selection: %s everything\n", beginAdd ? "add" : "remove");
+	for (const SelectionRule &rule: selection.getRules())
+	{
+		printf("  then %s intervals where %s %s %d%s\n", rule.add ? "add" : "remove",
+			rule.feature->getName().c_str(), SelectionRule::comparisonStr(rule.eq), rule.intensity,
+			rule.affectUnmarked ? " or not set" : "");
+	}
+
+	IntervalSet playIntervals;
+	Clock::time_point start = Clock::now();
+	selection.apply(playIntervals, wholeDuration);
+	double selectionTime = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	if (!filterText.empty())
+	{
+		Filter filter;
+		std::string error;
+		if (!Filter::parse(filterText, *features, filter, error))
+		{
+			fprintf(stderr, "filter \"%s\": %s\n", filterText.c_str(), error.c_str());
+			delete features;
+			return EXIT_FAILURE;
+		}
+		start = Clock::now();
+		filter.apply(playIntervals, wholeDuration);
+		selectionTime = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		printf("filter: %s (%zu terms), instead of selection\n", filter.toString().c_str(), filter.getTermsNum());
+	}
+
+	frame_id length = playIntervals.length();
+	printf("play intervals: %zu, length: %ld frames (%s), selection: %.3f ms\n", playIntervals.size(),
+		length, formatFrames(length, frameRate.toDouble()).c_str(), selectionTime);
+	if (listIntervals)
+	{
+		for (size_t i = 0; i < playIntervals.size(); i++)
+		{
+			printf("  %ld - %ld\n", playIntervals.getIn(i), playIntervals.getOut(i));
+		}
+	}
+	if (compareIntervals && filterText.empty() && compareIntervalSets(selection, playIntervals, wholeDuration, selectionTime) != EXIT_SUCCESS)
+	{
+		delete features;
+		return EXIT_FAILURE;
+	}
+
+	delete features;
+	return watch ? watchProject(file, useCache, genericReader) : EXIT_SUCCESS;
+}
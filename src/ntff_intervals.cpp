@@ -0,0 +1,159 @@
+#include "ntff_intervals.h"
+#include <algorithm>
+
+namespace Ntff {
+
+IntervalSet IntervalSet::fromIntervals(const std::vector<Interval> &intervals, int8_t min, int8_t max)
+{
+	IntervalSet res;
+	for (const Interval &interval: intervals)
+	{
+		if (interval.intensity >= min && interval.intensity <= max) { res.append(interval.in, interval.out); }
+	}
+	return res;
+}
+
+void IntervalSet::append(frame_id in, frame_id out)
+{
+	if (in >= out) { return; }
+	if (!outs.empty() && in <= outs.back())
+	{
+		if (out > outs.back())
+		{
+			lengths.back() += out - outs.back();
+			outs.back() = out;
+		}
+	}
+	else { push(in, out); }
+}
+
+void IntervalSet::push(frame_id in, frame_id out)
+{
+	ins.push_back(in);
+	outs.push_back(out);
+	lengths.push_back(length() + out - in);
+}
+
+size_t IntervalSet::find(frame_id in) const
+{
+	size_t res = findStarting(in);
+	return (res < size() && ins[res] == in) ? res : size();
+}
+
+size_t IntervalSet::findStarting(frame_id frame) const
+{
+	return std::lower_bound(ins.begin(), ins.end(), frame) - ins.begin();
+}
+
+size_t IntervalSet::findByStream(frame_id streamFrame) const
+{
+	return std::lower_bound(lengths.begin(), lengths.end(), streamFrame) - lengths.begin();
+}
+
+frame_id IntervalSet::toStream(frame_id frame) const
+{
+	size_t id = findFrom(frame);
+	frame_id res = lengthBefore(id);
+	if (id < size() && ins[id] < frame) { res += frame - ins[id]; }
+	return res;
+}
+
+size_t IntervalSet::findFrom(frame_id frame) const
+{
+	return std::upper_bound(outs.begin(), outs.end(), frame) - outs.begin();
+}
+
+void IntervalSet::unite(const IntervalSet &other)
+{
+	IntervalSet res;
+	res.reserve(size() + other.size());
+	size_t i = 0, j = 0;
+	while (i < size() || j < other.size())
+	{
+		if (j == other.size() || (i < size() && ins[i] <= other.ins[j])) { res.append(ins[i], outs[i]); i++; }
+		else { res.append(other.ins[j], other.outs[j]); j++; }
+	}
+	swap(res);
+}
+
+void IntervalSet::subtract(const IntervalSet &other)
+{
+	IntervalSet res;
+	res.reserve(size() + other.size());
+	size_t j = 0;
+	for (size_t i = 0; i < size(); i++)
+	{
+		frame_id in = ins[i];
+		frame_id out = outs[i];
+		while (j < other.size() && other.outs[j] <= in) { j++; }
+		//removed intervals may cover several of ours, so j is not advanced past the last overlapping one
+		for (size_t k = j; k < other.size() && other.ins[k] < out; k++)
+		{
+			if (other.ins[k] > in) { res.push(in, other.ins[k]); }
+			in = std::max(in, other.outs[k]);
+		}
+		if (in < out) { res.push(in, out); }
+	}
+	swap(res);
+}
+
+void IntervalSet::intersect(const IntervalSet &other)
+{
+	IntervalSet res;
+	res.reserve(size() + other.size());
+	size_t i = 0, j = 0;
+	while (i < size() && j < other.size())
+	{
+		res.append(std::max(ins[i], other.ins[j]), std::min(outs[i], other.outs[j]));
+		if (outs[i] < other.outs[j]) { i++; }
+		else { j++; }
+	}
+	swap(res);
+}
+
+frame_id IntervalSet::intersectionLength(const IntervalSet &other) const
+{
+	frame_id res = 0;
+	size_t i = 0, j = 0;
+	while (i < size() && j < other.size())
+	{
+		frame_id in = std::max(ins[i], other.ins[j]);
+		frame_id out = std::min(outs[i], other.outs[j]);
+		if (in < out) { res += out - in; }
+		if (outs[i] < other.outs[j]) { i++; }
+		else { j++; }
+	}
+	return res;
+}
+
+IntervalSet IntervalSet::complement(frame_id wholeDuration) const
+{
+	IntervalSet res;
+	frame_id prevOut = 0;
+	for (size_t i = 0; i < size() && prevOut < wholeDuration; i++)
+	{
+		res.append(prevOut, std::min(ins[i], wholeDuration));
+		prevOut = std::max(prevOut, outs[i]);
+	}
+	res.append(prevOut, wholeDuration);
+	return res;
+}
+
+void IntervalSet::insert(const Interval &interval)
+{
+	if (interval.in >= interval.out) { return; }
+	size_t pos = findStarting(interval.in);
+	ins.insert(ins.begin() + pos, interval.in);
+	outs.insert(outs.begin() + pos, interval.out);
+	lengths.insert(lengths.begin() + pos, 0);
+	for (size_t i = pos; i < size(); i++) { lengths[i] = lengthBefore(i) + outs[i] - ins[i]; }
+}
+
+void IntervalSet::reserve(size_t num)
+{
+	ins.reserve(num);
+	outs.reserve(num);
+	lengths.reserve(num);
+}
+
+}
@@ -0,0 +1,57 @@
+#ifndef NTFF_INTERVALS_H
+#define NTFF_INTERVALS_H
+
+#include <vector>
+#include <cstddef>
+#include "ntff_feature.h"
+
+namespace Ntff {
+
+/* Sorted disjoint intervals of frames, ins and outs in separate arrays.
+ * Bulk operations take another set and are a single linear merge, so
+ * a whole feature is added or removed at once. Touching intervals are
+ * merged by the operations, except the ones placed with insert().
+ * Cumulative lengths are kept along, so frames of the set (the stream
+ * the player plays) map to frames of the project by binary search. */
+class IntervalSet
+{
+public:
+	IntervalSet() {}
+	IntervalSet(const Interval &interval) { insert(interval); }
+	//union of the intervals (sorted by in, may overlap) with intensity in [min, max]
+	static IntervalSet fromIntervals(const std::vector<Interval> &intervals, int8_t min, int8_t max);
+
+	size_t size() const { return ins.size(); }
+	bool empty() const { return ins.empty(); }
+	void clear() { ins.clear(); outs.clear(); lengths.clear(); }
+	void swap(IntervalSet &other) { ins.swap(other.ins); outs.swap(other.outs); lengths.swap(other.lengths); }
+	Interval operator[](size_t id) const { return Interval(ins[id], outs[id]); }
+	frame_id getIn(size_t id) const { return ins[id]; }
+	frame_id getOut(size_t id) const { return outs[id]; }
+	frame_id length() const { return lengths.empty() ? 0 : lengths.back(); }
+	frame_id lengthBefore(size_t id) const { return id ? lengths[id - 1] : 0; } //of intervals before id
+	size_t find(frame_id in) const; //interval starting at in, size() if none
+	size_t findFrom(frame_id frame) const; //first interval containing frame or after it
+	size_t findStarting(frame_id frame) const; //first interval starting at frame or after it
+	size_t findByStream(frame_id streamFrame) const; //interval where stream frame is, its out included
+	frame_id toStream(frame_id frame) const; //frames of the set before frame
+
+	void unite(const IntervalSet &other);
+	void subtract(const IntervalSet &other);
+	void intersect(const IntervalSet &other);
+	frame_id intersectionLength(const IntervalSet &other) const; //without building the intersection
+	IntervalSet complement(frame_id wholeDuration) const; //within [0, wholeDuration)
+	void insert(const Interval &interval); //must not overlap the others, kept as is
+	void append(frame_id in, frame_id out); //after the last one, merged with it if they touch
+private:
+	std::vector<frame_id> ins;
+	std::vector<frame_id> outs;
+	std::vector<frame_id> lengths; //cumulative, of intervals up to and including the one
+
+	void push(frame_id in, frame_id out);
+	void reserve(size_t num);
+};
+
+}
+
+#endif // NTFF_INTERVALS_H
@@ -0,0 +1,54 @@
+#include "ntff_log.h"
+#include <cstdio>
+
+namespace Ntff {
+
+thread_local Log::Handler Log::handler = nullptr;
+thread_local void *Log::handlerData = nullptr;
+
+void Log::setHandler(Handler newHandler, void *data)
+{
+	handler = newHandler;
+	handlerData = data;
+}
+
+Log::Handler Log::getHandler(void *&data)
+{
+	data = handlerData;
+	return handler;
+}
+
+void Log::print(Level level, const char *format, va_list args)
+{
+	if (!handler) { return; }
+	
+	char message[1024];
+	vsnprintf(message, sizeof(message), format, args);
+	handler(handlerData, level, message);
+}
+
+void Log::err(const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	print(Error, format, args);
+	va_end(args);
+}
+
+void Log::warn(const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	print(Warning, format, args);
+	va_end(args);
+}
+
+void Log::dbg(const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	print(Debug, format, args);
+	va_end(args);
+}
+
+}
@@ -0,0 +1,30 @@
+#ifndef NTFF_LOG_H
+#define NTFF_LOG_H
+
+#include <cstdarg>
+
+namespace Ntff {
+
+/* Messages of the core, passed to the handler of the calling thread. Threads started
+ * for an input take the handler of the thread that opened it, so inputs opened side
+ * by side log to their own objects. */
+class Log
+{
+public:
+	enum Level { Error, Warning, Debug };
+	typedef void (*Handler)(void *data, Level level, const char *message);
+
+	static void setHandler(Handler handler, void *data); //for the calling thread, nullptr to stop
+	static Handler getHandler(void *&data); //of the calling thread, to set in threads it starts
+	static void err(const char *format, ...) __attribute__((format(printf, 1, 2)));
+	static void warn(const char *format, ...) __attribute__((format(printf, 1, 2)));
+	static void dbg(const char *format, ...) __attribute__((format(printf, 1, 2)));
+private:
+	static thread_local Handler handler;
+	static thread_local void *handlerData;
+	static void print(Level level, const char *format, va_list args);
+};
+
+}
+
+#endif // NTFF_LOG_H
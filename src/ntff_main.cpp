@@ -16,9 +16,30 @@
 
 #include "ntff_project.h"
 #include "ntff_player.h"
+#include "ntff_xml_vlc.h"
+#include "ntff_xml_fast.h"
+#include "ntff_log.h"
 
 static int Open(vlc_object_t *);
 static void Close(vlc_object_t *);
+
+#define BEGIN_ACTION_TEXT N_("Begin action")
+#define BEGIN_ACTION_LONGTEXT N_("What is done with the whole timeline before rules: add or remove. " \
+	"When set, playback starts without settings dialog (it is still shown by hotkey).")
+#define RULES_TEXT N_("Selection rules")
+#define RULES_LONGTEXT N_("Rules separated by ';', each is " \
+	"<feature>,<add|remove>,<comparison: < > <= >=>,<intensity>[,unmarked], " \
+	"or \"recommended\" for recommended settings of every feature. Used with begin action.")
+#define FILTER_TEXT N_("Filter expression")
+#define FILTER_LONGTEXT N_("Frames to play, e.g. \"violence >= 3 and not (language < 2)\": " \
+	"<feature> [<comparison> <intensity>], unmarked <feature>, all, combined with not, and, or " \
+	"and parentheses. When set, begin action and rules are not used and playback starts without dialog.")
+#define WATCH_TEXT N_("Reload project when it is saved")
+#define WATCH_LONGTEXT N_("Watch the project file while it is played and apply changes of the timeline " \
+	"and features without reopening it.")
+
+static const char *const beginActions[] = { "", "add", "remove" };
+static const char *const beginActionTexts[] = { N_("Ask with dialog"), N_("Add"), N_("Remove") };
  
 vlc_module_begin ()
     set_shortname ( "NTFF" )
@@ -28,6 +49,11 @@ vlc_module_begin ()
     set_capability( "demux", 90 )
     set_callbacks( Open, Close )
     add_shortcut( "ntff" )
+    add_string( "ntff-begin-action", "", BEGIN_ACTION_TEXT, BEGIN_ACTION_LONGTEXT, false )
+        change_string_list( beginActions, beginActionTexts )
+    add_string( "ntff-rules", "", RULES_TEXT, RULES_LONGTEXT, false )
+    add_string( "ntff-filter", "", FILTER_TEXT, FILTER_LONGTEXT, false )
+    add_bool( "ntff-watch", false, WATCH_TEXT, WATCH_LONGTEXT, false )
 vlc_module_end ()
 
 struct demux_sys_t
@@ -35,6 +61,17 @@ struct demux_sys_t
 	Ntff::Player *player;
 };
 
+static void LogHandler(void *data, Ntff::Log::Level level, const char *message)
+{
+	vlc_object_t *obj = (vlc_object_t *)data;
+	switch (level)
+	{
+		case Ntff::Log::Error: msg_Err(obj, "%s", message); break;
+		case Ntff::Log::Warning: msg_Warn(obj, "%s", message); break;
+		default: msg_Dbg(obj, "%s", message);
+	}
+}
+
 static int Control(demux_t *p_demux, int i_query, va_list args)
 {
 	return p_demux->p_sys->player->control(i_query, args);
@@ -46,6 +83,16 @@ static int Demux(demux_t * p_demux)
 	return p_sys->player->play();
 }
 
+//VLC does not call Close after failed Open, threads of the player must not outlive it
+static int OpenFailed(demux_t *p_demux)
+{
+	delete p_demux->p_sys->player; //joins its threads
+	delete p_demux->p_sys;
+	p_demux->p_sys = nullptr;
+	Ntff::Log::setHandler(nullptr, nullptr);
+	return VLC_EGENERIC;
+}
+
 static int Open(vlc_object_t *p_this)
 {	
 	demux_t *p_demux = (demux_t *)p_this;
@@ -55,11 +102,42 @@ static int Open(vlc_object_t *p_this)
 	p_demux->pf_demux = Demux;
     p_demux->pf_control = Control;
 		
-	Ntff::Project project(p_this, p_demux->psz_file, p_demux->s);
-	if (!project.isValid()) { return VLC_EGENERIC; }
+	if (!p_demux->psz_file) { return OpenFailed(p_demux); }
+	Ntff::Log::setHandler(LogHandler, p_this); //for this thread, threads of the player take it from here
+	
+	double openTime = 0;
+	{
+		Ntff::PhaseTimer timer(openTime);
+		Ntff::Project *project = new Ntff::Project(p_demux->psz_file, [p_this, p_demux]() { 
+			return Ntff::FastXmlReader::create(p_demux->psz_file, [p_this, p_demux]() {
+				return Ntff::VlcXmlReader::create(p_this, p_demux->s); 
+			});
+		});
+		if (!project->isValid())
+		{
+			delete project;
+			return OpenFailed(p_demux);
+		}
+		
+		p_sys->player = Ntff::Player::create(p_demux, project); //takes ownership of project
+	}
+	p_sys->player->publishStats(openTime);
+	if (!p_sys->player->isValid()) { return OpenFailed(p_demux); }
 	
-	p_sys->player = project.createPlayer(p_demux);
-	if (!p_sys->player->isValid()) { return VLC_EGENERIC; }
+	char *beginAction = var_InheritString(p_demux, "ntff-begin-action");
+	char *rules = var_InheritString(p_demux, "ntff-rules");
+	char *filter = var_InheritString(p_demux, "ntff-filter");
+	if (filter && *filter)
+	{
+		if (!p_sys->player->selectFilter(filter)) { msg_Warn(p_demux, "Filter is not applied, asking with dialog"); }
+	}
+	else if (beginAction && *beginAction && !p_sys->player->selectPreset(beginAction, rules ? rules : ""))
+	{
+		msg_Warn(p_demux, "Preset selection is not applied, asking with dialog");
+	}
+	free(beginAction);
+	free(rules);
+	free(filter);
 	
 	return VLC_SUCCESS;
 }
@@ -68,4 +146,6 @@ static void Close(vlc_object_t *obj)
 {
 	demux_t *p_demux = (demux_t *)obj;
 	delete p_demux->p_sys->player;
+	delete p_demux->p_sys;
+	Ntff::Log::setHandler(nullptr, nullptr);
 }
@@ -0,0 +1,118 @@
+#include "ntff_media_cache.h"
+#include "ntff_log.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <sys/stat.h>
+
+namespace Ntff {
+
+static const char *cacheHeader = "ntff-media 1";
+
+MediaCache::MediaCache(const std::string &path): path(path), hitsNum(0), changed(false)
+{
+	if (!path.empty()) { load(); }
+}
+
+std::string MediaCache::defaultPath()
+{
+	const char *dir = getenv("XDG_CACHE_HOME");
+	if (dir && *dir) { return std::string(dir) + "/ntff/media.cache"; }
+	const char *home = getenv("HOME");
+	if (home && *home) { return std::string(home) + "/.cache/ntff/media.cache"; }
+	return std::string();
+}
+
+bool MediaCache::statFile(const std::string &file, uint64_t &size, int64_t &mtime)
+{
+	struct stat st;
+	if (stat(file.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) { return false; }
+	size = st.st_size;
+	mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+	return true;
+}
+
+//line: size, mtime, duration, fps num, fps den, first frame offset, module, then tab and path
+void MediaCache::load()
+{
+	std::ifstream in(path);
+	std::string line;
+	if (!std::getline(in, line) || line != cacheHeader) { return; }
+
+	while (std::getline(in, line))
+	{
+		std::stringstream ss(line);
+		Record record;
+		std::string file;
+		ss >> record.size >> record.mtime >> record.info.duration >> record.info.frameRateNum
+			>> record.info.frameRateDen >> record.info.firstFrameOffset >> record.info.module;
+		if (!ss || ss.get() != '\t' || !std::getline(ss, file) || file.empty()) { continue; }
+		records[file] = record;
+	}
+}
+
+bool MediaCache::lookup(const std::string &file, MediaInfo &info) const
+{
+	uint64_t size;
+	int64_t mtime;
+	if (!statFile(file, size, mtime)) { return false; }
+
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = records.find(file);
+	if (it == records.end() || it->second.size != size || it->second.mtime != mtime) { return false; }
+	info = it->second.info;
+	hitsNum++;
+	return true;
+}
+
+void MediaCache::store(const std::string &file, const MediaInfo &info)
+{
+	if (file.find_first_of("\t\n") != std::string::npos || info.module.empty() ||
+		info.module.find_first_of(" \t\n") != std::string::npos)
+	{
+		return;
+	}
+	Record record;
+	if (!statFile(file, record.size, record.mtime)) { return; }
+	record.info = info;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	records[file] = record;
+	changed = true;
+}
+
+bool MediaCache::save()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!changed || path.empty()) { return true; }
+
+	std::error_code ec;
+	std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+
+	//write to temporary file first, so concurrent players never read partial cache
+	std::string tmpPath = path + ".tmp";
+	{
+		std::ofstream out(tmpPath, std::ios::trunc);
+		if (!out) { return false; }
+		out << cacheHeader << '\n';
+		for (const auto &it: records)
+		{
+			const Record &r = it.second;
+			out << r.size << ' ' << r.mtime << ' ' << r.info.duration << ' ' << r.info.frameRateNum << ' '
+				<< r.info.frameRateDen << ' ' << r.info.firstFrameOffset << ' ' << r.info.module << '\t'
+				<< it.first << '\n';
+		}
+		if (!out) { out.close(); remove(tmpPath.c_str()); return false; }
+	}
+	if (rename(tmpPath.c_str(), path.c_str()) != 0)
+	{
+		remove(tmpPath.c_str());
+		return false;
+	}
+	changed = false;
+	return true;
+}
+
+}
@@ -0,0 +1,55 @@
+#ifndef NTFF_MEDIA_CACHE_H
+#define NTFF_MEDIA_CACHE_H
+
+#include <string>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+
+namespace Ntff {
+
+struct MediaInfo
+{
+	MediaInfo(): duration(0), frameRateNum(0), frameRateDen(0), firstFrameOffset(0) {}
+	std::string module;       //demux module that opened the file
+	int64_t duration;         //us, as reported by demuxer
+	int32_t frameRateNum;     //of video stream, 0 if unknown
+	int32_t frameRateDen;
+	int64_t firstFrameOffset; //us, pts of first video block (B-frames)
+};
+
+/* What was learned while opening media files, kept across sessions in the user
+ * cache directory, so the demux module is named explicitly and the first block
+ * is not played again. Records are keyed by path and valid while size and mtime
+ * of the file are the same. Thread-safe, items are opened from several threads. */
+class MediaCache
+{
+public:
+	MediaCache(const std::string &path = defaultPath());
+	bool lookup(const std::string &file, MediaInfo &info) const;
+	void store(const std::string &file, const MediaInfo &info);
+	bool save(); //only if changed
+	size_t getHitsNum() const { return hitsNum; }
+
+	static std::string defaultPath();
+private:
+	struct Record
+	{
+		uint64_t size;
+		int64_t mtime;
+		MediaInfo info;
+	};
+
+	std::string path;
+	std::unordered_map<std::string, Record> records;
+	mutable std::mutex mutex;
+	mutable size_t hitsNum;
+	bool changed;
+
+	void load();
+	static bool statFile(const std::string &file, uint64_t &size, int64_t &mtime);
+};
+
+}
+
+#endif // NTFF_MEDIA_CACHE_H
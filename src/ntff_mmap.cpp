@@ -0,0 +1,54 @@
+#include "ntff_mmap.h"
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace Ntff {
+
+MappedFile::MappedFile(const std::string &path): data(nullptr), size(0), mtime(0)
+{
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) { return; }
+
+	struct stat st;
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+	{
+		void *ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (ptr != MAP_FAILED)
+		{
+			data = (const uint8_t *)ptr;
+			size = st.st_size;
+			mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+		}
+	}
+	close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+	if (data) { munmap((void *)data, size); }
+}
+
+uint64_t MappedFile::hash(const uint8_t *data, size_t size)
+{
+	//FNV-1a over 64-bit words, tail bytes are folded in one by one
+	const uint64_t prime = 0x100000001b3ULL;
+	uint64_t res = 0xcbf29ce484222325ULL ^ size;
+	size_t pos = 0;
+	for (; pos + sizeof(uint64_t) <= size; pos += sizeof(uint64_t))
+	{
+		uint64_t word;
+		memcpy(&word, data + pos, sizeof(word));
+		res = (res ^ word) * prime;
+		res ^= res >> 32;
+	}
+	for (; pos < size; pos++)
+	{
+		res = (res ^ data[pos]) * prime;
+	}
+	return res;
+}
+
+}
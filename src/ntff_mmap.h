@@ -0,0 +1,32 @@
+#ifndef NTFF_MMAP_H
+#define NTFF_MMAP_H
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+namespace Ntff {
+
+class MappedFile
+{
+public:
+	MappedFile(const std::string &path);
+	~MappedFile();
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	bool isValid() const { return data != nullptr; }
+	const uint8_t *getData() const { return data; }
+	size_t getSize() const { return size; }
+	int64_t getMtime() const { return mtime; } //nanoseconds
+
+	static uint64_t hash(const uint8_t *data, size_t size);
+private:
+	const uint8_t *data;
+	size_t size;
+	int64_t mtime;
+};
+
+}
+
+#endif // NTFF_MMAP_H
@@ -2,6 +2,13 @@
 #include "ntff_es.h"
 #include "ntff_feature.h"
 #include "ntff_dialog.h"
+#include "ntff_project.h"
+#include "ntff_selection.h"
+#include "ntff_filter.h"
+#include "ntff_watcher.h"
+#include "ntff_xml_vlc.h"
+#include "ntff_xml_fast.h"
+#include "ntff_media_cache.h"
 #include <vlc_stream_extractor.h>
 #include <vlc_demux.h>
 #include <vlc_actions.h>
@@ -9,7 +16,11 @@
 #include <vlc_threads.h>
 #include <vlc_codec.h>
 #include <vlc_block.h>
+#include <vlc_modules.h>
 #include <utility>
+#include <algorithm>
+#include <iterator>
+#include <sstream>
 using namespace std;
 #include <atomic>
 struct input_clock_t;
@@ -61,50 +72,326 @@ static int ActionEvent( vlc_object_t *, char const *, vlc_value_t, vlc_value_t n
 	return VLC_SUCCESS;
 }
 
-Player::Player(demux_t *obj, FeatureList *featureList, double fps) : 
-	obj(obj), featureList(featureList), fps(fps)
+Player::Player(demux_t *obj, const FrameRate &frameRate) : 
+	obj(obj), featureList(nullptr), frameRate(frameRate)
 {
 	demux_t *demuxer = (demux_t *)obj;
 	out = new OutStream(demuxer->out, this);
 	preload = new PreloadVideoStream(demuxer->out, this, out);
 	intervalsSelected = false;
-	length = 0;
-	curInterval = playIntervals.begin();
+	length = wholeDuration = 0;
+	curInterval = 0;
+	seekPending = false;
+	publishedIntervals = nullptr;
 	vlc_mutex_init(&intervalsMutex);
-	dialog = new Dialog(this, featureList);
+	vlc_mutex_init(&featuresMutex);
+	vlc_mutex_init(&dialogMutex);
+	vlc_mutex_init(&itemsMutex);
+	vlc_cond_init(&itemsCond);
+	itemsLoading = false;
+	itemsCancel = false;
+	itemsReadyTo = 0;
+	pendingEntries = nullptr;
+	dialog = nullptr; //created on first show, when features are ready
+	project = nullptr;
+	watcher = nullptr;
+	featuresLoading = false;
+	preparedItem = nullptr;
+	preparedFrame = 0;
+	savedFrameId = 0;
+	presetSelection = nullptr;
+	presetFilter = nullptr;
+	mediaCache = new MediaCache();
+	logHandler = Log::getHandler(logData);
 	var_AddCallback( obj->obj.libvlc, "key-action", ActionEvent, this);
 }
 
+Player *Player::create(demux_t *demux, Project *project)
+{
+	Player *player = new Player(demux, project->getFrameRate());
+	player->stats = project->getStats();
+	//only the first item is opened before playback starts, the rest are opened in background
+	const std::vector<MediaEntry> &entries = project->getMediaEntries();
+	if (!entries.empty()) { player->setDuration(entries.back().interval.out); }
+	player->loadFeatures(project); //before the first item, which is the part of open VLC waits for
+	if (!entries.empty())
+	{
+		player->addFile(entries.front().interval, entries.front().resource);
+		player->loadItems(std::vector<MediaEntry>(entries.begin() + 1, entries.end()));
+	}
+	if (!player->pendingEntries) { player->mediaCache->save(); }
+	player->out->enableOutput();
+	if (var_InheritBool(demux, "ntff-watch"))
+	{
+		player->watcher = new FileWatcher(demux->psz_file, [player]() { player->reloadProject(); });
+	}
+	return player;
+}
+
 Player::~Player()
 {
-	delete featureList;
+	delete watcher; //no reloads from now on
+	stopLoadingItems();
+	mediaCache->save();
+	delete mediaCache;
+	vlc_mutex_lock(&dialogMutex);
+	materializeFeatures();
+	vlc_mutex_unlock(&dialogMutex);
+	if (preparedItem) { preparedItem->waitPrepared(); }
+	delete project;
 	delete out;
 	delete preload;
 	delete dialog;
+	delete featureList;
+	delete presetSelection;
+	delete presetFilter;
+	delete publishedIntervals.load();
 	vlc_mutex_destroy(&intervalsMutex);
+	vlc_mutex_destroy(&featuresMutex);
+	vlc_mutex_destroy(&dialogMutex);
+	vlc_mutex_destroy(&itemsMutex);
+	vlc_cond_destroy(&itemsCond);
 	var_DelCallback( obj->obj.libvlc, "key-action", ActionEvent, this);
 }
 
-bool Player::isValid() const
+bool Player::isValid() const //items opened so far
 {
-	if (items.empty()) return false;
+	vlc_mutex_lock(&itemsMutex);
+	bool res = !items.empty();
+	for (auto it = items.begin(); res && it != items.end(); it++)
+	{
+		if (!(*it).second.isValid()) res = false;
+	}
+	vlc_mutex_unlock(&itemsMutex);
+	return res;
+}
+
+void Player::publishStats(double openTime)
+{
+	stats.openTime = openTime;
+	vlc_object_t *vlcObj = getVlcObj();
+	stats.visit([vlcObj] (const char *name, double ms)
+	{
+		std::string var = std::string("ntff-") + name;
+		var_Create(vlcObj, var.c_str(), VLC_VAR_FLOAT);
+		var_SetFloat(vlcObj, var.c_str(), ms);
+	}, [vlcObj] (const char *name, size_t value)
+	{
+		std::string var = std::string("ntff-") + name;
+		var_Create(vlcObj, var.c_str(), VLC_VAR_INTEGER);
+		var_SetInteger(vlcObj, var.c_str(), value);
+	});
+	msg_Dbg(obj, "Open stats: %s", stats.toString().c_str());
+}
+
+bool Player::selectPreset(const std::string &beginAction, const std::string &rules)
+{
+	bool add;
+	if (!Selection::parseAction(beginAction, add))
+	{
+		msg_Err(obj, "Unknown begin action \"%s\"", beginAction.c_str());
+		return false;
+	}
+	vlc_mutex_lock(&dialogMutex);
+	materializeFeatures(); //rules refer to features
+	vlc_mutex_unlock(&dialogMutex);
 	
-	for (auto it = items.begin(); it != items.end(); it++)
+	Selection *selection = new Selection();
+	if (rules == "recommended") { *selection = Selection::recommended(*featureList); }
+	else
 	{
-		if (!(*it).second.isValid()) return false;
+		std::stringstream ss(rules);
+		std::string text;
+		while (std::getline(ss, text, ';'))
+		{
+			if (text.empty()) { continue; }
+			SelectionRule rule;
+			std::string error;
+			if (!Selection::parseRule(text, *featureList, rule, error))
+			{
+				msg_Err(obj, "Rule \"%s\": %s", text.c_str(), error.c_str());
+				delete selection;
+				return false;
+			}
+			selection->append(rule);
+		}
 	}
+	selection->setBeginAction(add);
+	setPreset(selection, nullptr);
+	return true;
+}
+
+bool Player::selectFilter(const std::string &text)
+{
+	vlc_mutex_lock(&dialogMutex);
+	materializeFeatures(); //expression refers to features
+	vlc_mutex_unlock(&dialogMutex);
 	
+	Filter *filter = new Filter();
+	std::string error;
+	if (!Filter::parse(text, *featureList, *filter, error))
+	{
+		msg_Err(obj, "Filter \"%s\": %s", text.c_str(), error.c_str());
+		delete filter;
+		return false;
+	}
+	setPreset(nullptr, filter);
 	return true;
 }
 
+void Player::setPreset(Selection *selection, Filter *filter)
+{
+	delete presetSelection;
+	delete presetFilter;
+	presetSelection = selection;
+	presetFilter = filter;
+	
+	vlc_mutex_lock(&intervalsMutex);
+	vlc_mutex_lock(&featuresMutex);
+	applyPreset(playIntervals);
+	vlc_mutex_unlock(&featuresMutex);
+	recalcLength();
+	curInterval = 0;
+	if (playIntervals.empty()) { msg_Warn(obj, "Preset selection is empty, nothing to play"); }
+	else
+	{
+		Interval first = getCurInterval();
+		seek(first.in, 0);
+		prepareNextInterval();
+	}
+	intervalsSelected = true;
+	vlc_mutex_unlock(&intervalsMutex);
+	std::string text = filter ? filter->toString() : Filter::fromSelection(*selection).toString();
+	msg_Dbg(obj, "Preset selection: %s, %zu intervals", text.c_str(), playIntervals.size());
+}
+
+//rules go row by row over unions features keep, which is not slower than the sweep on dense
+//features; the sweep is used for expressions only
+void Player::applyPreset(IntervalSet &intervals) const //under featuresMutex
+{
+	if (presetSelection) { presetSelection->apply(intervals, wholeDuration); }
+	else if (presetFilter) { presetFilter->apply(intervals, wholeDuration); }
+}
+
 void Player::addFile(const Interval &interval, const std::string &filename)
 {
-	out->reuseStreams();
-	items[interval.in] = Item(this, interval, out->getWrapperStream(), preload, filename);
-	length = wholeDuration = interval.out;
-	playIntervals[0] = Interval(0, wholeDuration);
-	curInterval = playIntervals.begin();
-	needInitItems = true;
+	PhaseTimer timer(stats.demuxTime);
+	Item item = createItem(interval, filename);
+	stats.demuxers += item.getDemuxersNum();
+	insertItem(item);
+	if (interval.out > wholeDuration) { setDuration(interval.out); }
+}
+
+void Player::setDuration(frame_id duration)
+{
+	length = wholeDuration = duration;
+	playIntervals = IntervalSet(Interval(0, wholeDuration));
+	curInterval = 0;
+}
+
+Player::Item Player::createItem(const Interval &interval, const std::string &filename)
+{
+	//known files are opened with the module that won last time, and not played to find first frame
+	MediaInfo info;
+	bool known = mediaCache->lookup(filename, info);
+	
+	out->reuseStreams(); //n-th stream of every item is the same, cursors are kept per thread
+	OutStream::beginProbe(); //format and first block of video are taken from what this thread sends
+	Item item(this, interval, out->getWrapperStream(), preload, filename, known ? info.module : "any");
+	if (item.isValid() && !known)
+	{
+		for (int i = 0; i < 64 && !OutStream::probeDone(); i++)
+		{
+			if (item.play() != VLC_DEMUXER_SUCCESS) { break; }
+		}
+	}
+	OutStream::Probe probe = OutStream::endProbe();
+	if (!item.isValid()) { return item; }
+	
+	if (!known)
+	{
+		info.module = item.getModule();
+		info.duration = item.getDuration();
+		info.frameRateNum = probe.frameRate;
+		info.frameRateDen = probe.frameRateBase;
+		info.firstFrameOffset = probe.time;
+		if (probe.done) { mediaCache->store(filename, info); }
+	}
+	if (info.duration > 0 && getFramesTime(interval.length() - 1) > info.duration)
+	{
+		msg_Warn(obj, "%s is shorter than its entry in the project", filename.c_str());
+	}
+	item.setFirstFrameOffset(info.firstFrameOffset);
+	item.skip(interval.in);
+	return item;
+}
+
+void Player::insertItem(const Item &item)
+{
+	vlc_mutex_lock(&itemsMutex);
+	items[item.getInterval().in] = item;
+	itemsReadyTo = std::max(itemsReadyTo, item.getInterval().out);
+	vlc_cond_broadcast(&itemsCond);
+	vlc_mutex_unlock(&itemsMutex);
+}
+
+void Player::loadItems(const std::vector<MediaEntry> &entries)
+{
+	if (entries.empty()) { return; }
+	pendingEntries = new std::vector<MediaEntry>(entries);
+	auto loadFunc = [] (void *player) -> void *
+	{
+		Player *p = (Player *)player;
+		Log::setHandler(p->logHandler, p->logData);
+		double time = 0;
+		{
+			PhaseTimer timer(time);
+			for (const MediaEntry &entry: *p->pendingEntries)
+			{
+				vlc_mutex_lock(&p->itemsMutex);
+				bool cancel = p->itemsCancel;
+				vlc_mutex_unlock(&p->itemsMutex);
+				if (cancel) { break; }
+				
+				Item item = p->createItem(entry.interval, entry.resource);
+				if (!item.isValid()) { msg_Err(p->obj, "Unable to open %s", entry.resource.c_str()); }
+				p->insertItem(item);
+			}
+		}
+		vlc_mutex_lock(&p->itemsMutex);
+		p->itemsLoading = false;
+		vlc_cond_broadcast(&p->itemsCond);
+		vlc_mutex_unlock(&p->itemsMutex);
+		
+		vlc_object_t *vlcObj = p->getVlcObj();
+		var_Create(vlcObj, "ntff-items-time", VLC_VAR_FLOAT);
+		var_SetFloat(vlcObj, "ntff-items-time", time);
+		msg_Dbg(vlcObj, "Remaining %zu items opened in %.3f ms, %zu media files known from cache", 
+			p->pendingEntries->size(), time, p->mediaCache->getHitsNum());
+		p->mediaCache->save();
+		return nullptr;
+	};
+	
+	itemsLoading = true;
+	if (vlc_clone(&itemsThread, loadFunc, this, VLC_THREAD_PRIORITY_LOW) != 0)
+	{
+		msg_Warn(obj, "Unable to start items thread, opening items before playback");
+		itemsLoading = false;
+		for (const MediaEntry &entry: entries) { addFile(entry.interval, entry.resource); }
+		delete pendingEntries;
+		pendingEntries = nullptr;
+	}
+}
+
+void Player::stopLoadingItems()
+{
+	if (!pendingEntries) { return; }
+	vlc_mutex_lock(&itemsMutex);
+	itemsCancel = true;
+	vlc_mutex_unlock(&itemsMutex);
+	vlc_join(itemsThread, nullptr);
+	delete pendingEntries;
+	pendingEntries = nullptr;
 }
 
 bool Player::frameIsInPlayInterval(frame_id frame) const
@@ -124,16 +411,26 @@ mtime_t Player::getCurOffset() const
 
 void Player::prepareNextInterval()
 {
+	if (preparedItem) //only one preload at a time
+	{
+		preparedItem->waitPrepared();
+		preparedItem = nullptr;
+	}
 	Interval nextInterval = getNextInterval();
-	if (nextInterval.length() > 0)
+	//callers may hold intervalsMutex, an item still opened in background is seeked to when reached
+	if (nextInterval.length() > 0 && itemsReadyAt(nextInterval.in))
 	{
-		getItemAt(nextInterval.in)->prepare(nextInterval.in);
+		Item *item = getItemAt(nextInterval.in);
+		if (!item || !item->isValid()) { return; }
+		preparedItem = item;
+		preparedFrame = nextInterval.in;
+		preparedItem->prepare(nextInterval.in);
 	}
 }
 
 int Player::getFrameId(mtime_t timeInItem) const
 {
-	return round((double)(timeInItem - getCurOffset()) / getFrameLen());
+	return frameRate.timeToFrames(timeInItem - getCurOffset());
 }
 
 frame_id Player::getCurIntervalFirstFrame() const
@@ -143,7 +440,10 @@ frame_id Player::getCurIntervalFirstFrame() const
 
 void Player::setIntervalsSelected()
 {
-	Interval &newInterval = curInterval->second;
+	vlc_mutex_lock(&intervalsMutex);
+	takePublishedIntervals(); //last selection of the dialog
+	vlc_mutex_unlock(&intervalsMutex);
+	Interval newInterval = getCurInterval();
 	frame_id targetFrame = newInterval.contains(savedFrameId) ? savedFrameId : newInterval.in;
 	
 	msg_Dbg(obj, "Seek to %li", targetFrame);
@@ -159,107 +459,216 @@ void Player::showDialog()
 	setPause(true);
 	intervalsSelected = false; 
 	savedFrameId = getGlobalFrame();
-	dialog->show();
+	getDialog()->show();
 }
 
 void Player::hideDialog()
 {
-	dialog->hide();
+	getDialog()->hide();
 }
 
-frame_id Player::getGlobalFrame() const
+bool Player::dialogIsShown()
 {
-	return getCurInterval().in + out->getHandledFrameId();
+	vlc_mutex_lock(&dialogMutex);
+	bool res = dialog && dialog->isShown();
+	vlc_mutex_unlock(&dialogMutex);
+	return res;
 }
 
-void Player::lockIntervals(bool lock)
+void Player::loadFeatures(Project *project)
 {
-	if (lock) { vlc_mutex_lock(&intervalsMutex); }
-	else {vlc_mutex_unlock(&intervalsMutex);}
+	//feature tracks are parsed with the project, features (intervals and their indexes)
+	//are not needed until dialog is shown, so they are built while items are opened
+	this->project = project;
+	auto loadFunc = [] (void *player) -> void *
+	{
+		Player *p = (Player *)player;
+		Log::setHandler(p->logHandler, p->logData);
+		double time = 0;
+		{
+			PhaseTimer timer(time);
+			FeatureList *features = p->project->generateFeatureList();
+			//unions of intensities, unmarked frames and intensity layers, so first selection
+			//and lengths of dialog values are bulk operations only
+			for (const Feature *feature: *features) { feature->prepareIndex(p->wholeDuration); }
+			p->featureList = features;
+		}
+		vlc_object_t *vlcObj = p->getVlcObj();
+		var_Create(vlcObj, "ntff-features-time", VLC_VAR_FLOAT);
+		var_SetFloat(vlcObj, "ntff-features-time", time);
+		msg_Dbg(vlcObj, "Features materialized in %.3f ms", time);
+		p->project->indexSections(); //for incremental reload
+		return nullptr;
+	};
+	
+	featuresLoading = vlc_clone(&featuresThread, loadFunc, this, VLC_THREAD_PRIORITY_LOW) == 0;
+	if (!featuresLoading) { msg_Warn(obj, "Unable to start features thread, loading features on demand"); }
 }
 
-void Player::resetIntervals(bool empty)
+void Player::materializeFeatures() //under dialogMutex
 {
-	playIntervals.clear();
-	if (!empty)
+	if (featuresLoading)
 	{
-		Interval res(0, wholeDuration);
-		playIntervals[res.in] = res;
+		vlc_join(featuresThread, nullptr);
+		featuresLoading = false;
 	}
+	else if (!featureList && project) { featureList = project->generateFeatureList(); }
 }
 
-void Player::modifyIntervals(bool add, const Feature *f, 
-	int8_t minIntensity, int8_t maxIntensity, bool affectUnmarked)
+void Player::reloadProject() //from watcher thread
 {
-	auto modify = add ? &FeatureList::insertInterval : &FeatureList::removeInterval;
+	ProjectUpdate update;
+	vlc_mutex_lock(&dialogMutex);
+	materializeFeatures();
+	auto createReader = [this] (const char *data, size_t size) 
+	{
+		return FastXmlReader::create(data, size, [this, data, size]() {
+			return VlcXmlReader::create(getVlcObj(), data, size);
+		});
+	};
+	bool ok = project && featureList && project->reload(createReader, update);
+	Dialog *curDialog = dialog;
+	vlc_mutex_unlock(&dialogMutex);
+	
+	if (!ok) { msg_Warn(obj, "Unable to reload project, keeping previous version"); return; }
+	if (update.mediaChanged) { msg_Warn(obj, "Media files of the project changed, reopen it to apply"); }
+	if (update.features.empty() && update.removedFeatures.empty()) { return; }
+	msg_Dbg(obj, "Project reloaded: %zu features changed, %zu removed", 
+		update.features.size(), update.removedFeatures.size());
 	
-	const std::vector<Interval> &featureIntervals = f->getIntervals();
-	for (const Interval &interval: featureIntervals)
+	vlc_mutex_lock(&intervalsMutex);
+	vlc_mutex_lock(&featuresMutex);
+	for (const Feature *feature: update.features)
 	{
-		if (interval.intensity >= minIntensity && interval.intensity <= maxIntensity)
-		{
-			modify(playIntervals, interval);
-		}
+		Feature *cur = featureList->find(feature->getName());
+		if (cur) { cur->setIntervals(feature->getIntervals()); }
+		else { msg_Warn(obj, "New feature %s will be available after reopening", feature->getName().c_str()); }
 	}
-	if (affectUnmarked)
+	for (const std::string &name: update.removedFeatures)
 	{
-		frame_id prevOut = 0; 
-		for (const Interval &interval: featureIntervals)
-		{
-			msg_Dbg(obj, "%s %li - %li", add ? "add" : "remove", prevOut, interval.in);
-			modify(playIntervals, Interval(prevOut, interval.in));
-			prevOut = interval.out;
-		}
-		msg_Dbg(obj, "%s %li - %li", add ? "add" : "remove", prevOut, wholeDuration);
-		modify(playIntervals, Interval(prevOut, wholeDuration));
+		Feature *cur = featureList->find(name);
+		if (cur) { cur->setIntervals(std::vector<Interval>()); }
 	}
+	
+	if (!curDialog && (presetSelection || presetFilter)) //rules and terms point to updated features
+	{
+		IntervalSet intervals;
+		applyPreset(intervals);
+		vlc_mutex_unlock(&featuresMutex);
+		patchIntervals(intervals);
+	}
+	else { vlc_mutex_unlock(&featuresMutex); }
+	vlc_mutex_unlock(&intervalsMutex);
+	
+	//widgets are read under the dialog's lock, demux thread patches intervals it takes while playing
+	if (curDialog) { curDialog->applyUserSelection(true); }
 }
 
-void Player::recalcLength()
+void Player::patchIntervals(IntervalSet &intervals) //under intervalsMutex
 {
-	length = 0;
-	for (auto &p: playIntervals)
+	if (curInterval == playIntervals.size())
 	{
-		length += p.second.length();
+		playIntervals.swap(intervals);
+		curInterval = playIntervals.size();
+		recalcLength();
+		return;
 	}
-	msg_Dbg(obj, "Player Intervals (%li)", playIntervals.size());
-	for (auto p: playIntervals)
+	
+	//current interval is kept up to played position (and further, if it is still selected),
+	//so playback goes on without seek
+	Interval cur = getCurInterval();
+	frame_id position = std::min(cur.in + out->getHandledFrameId(), cur.out);
+	frame_id end = position;
+	size_t containing = intervals.findFrom(position);
+	if (containing < intervals.size() && intervals[containing].contains(position))
 	{
-		msg_Dbg(obj, "~~~~interval: %li - %li", p.second.in, p.second.out);
+		end = intervals.getOut(containing);
 	}
+	if (end == cur.in) //nothing of it was played and it is not selected anymore, the next one is played
+	{
+		playIntervals.swap(intervals);
+		curInterval = playIntervals.findFrom(cur.in);
+		recalcLength();
+		out->resetFramesNum();
+		seekPending = true; //its item may still be loading, not waited for under the lock
+		prepareNextInterval();
+		return;
+	}
+	
+	//kept apart from its neighbours, so its in (and played position) is the same
+	intervals.subtract(IntervalSet(Interval(cur.in, end)));
+	intervals.insert(Interval(cur.in, end));
+	
+	playIntervals.swap(intervals);
+	curInterval = playIntervals.find(cur.in);
+	recalcLength();
+	
+	Interval next = getNextInterval();
+	if (!preparedItem || preparedFrame != next.in) { prepareNextInterval(); }
 }
 
-void Player::updateCurrentInterval()
+Dialog *Player::getDialog()
 {
-	if (savedFrameId)
+	vlc_mutex_lock(&dialogMutex);
+	if (!dialog)
 	{
-		auto closestIt = playIntervals.lower_bound(savedFrameId);
-		if (closestIt == playIntervals.end()) 
-		{
-			closestIt = playIntervals.begin(); 
-		}
-		else if (closestIt != playIntervals.begin())
-		{
-			closestIt--; //select prev interval, if it contains our timestamp
-			if (closestIt->second.out <= savedFrameId)
-			{
-				closestIt++;
-			}
-		}
-		curInterval = closestIt;
+		materializeFeatures();
+		dialog = new Dialog(this, featureList);
 	}
-	else { curInterval = playIntervals.begin(); }
+	vlc_mutex_unlock(&dialogMutex);
+	return dialog;
 }
 
-frame_id Player::getStreamLengthTo(frame_id targetFrame) const
+frame_id Player::getGlobalFrame() const
+{
+	return getCurInterval().in + out->getHandledFrameId();
+}
+
+void Player::lockFeatures(bool lock)
+{
+	if (lock) { vlc_mutex_lock(&featuresMutex); }
+	else { vlc_mutex_unlock(&featuresMutex); }
+}
+
+//dialog builds new intervals without locks and hands them over here, demux thread goes on
+void Player::publishPlayIntervals(IntervalSet *intervals)
 {
-	frame_id res = 0;
-	for (auto &p: playIntervals)
+	delete publishedIntervals.exchange(intervals); //previous ones were not taken, nobody holds them
+}
+
+//under intervalsMutex, only holders of it read playIntervals, so the old ones are freed at once
+bool Player::takePublishedIntervals()
+{
+	if (!publishedIntervals.load(std::memory_order_relaxed)) { return false; }
+	IntervalSet *published = publishedIntervals.exchange(nullptr);
+	if (!published) { return false; }
+	if (intervalsSelected) { patchIntervals(*published); } //selection changed on reload, playback goes on
+	else
 	{
-		if (p.first >= targetFrame) return res;
-		res += p.second.length();
+		playIntervals.swap(*published);
+		recalcLength();
+		updateCurrentInterval();
 	}
-	return res;
+	delete published;
+	return true;
+}
+
+void Player::recalcLength()
+{
+	length = playIntervals.length();
+	msg_Dbg(obj, "Player Intervals (%zu)", playIntervals.size()); //not listed, runs under intervalsMutex
+}
+
+void Player::updateCurrentInterval()
+{
+	//interval containing saved frame or the next one, from the beginning if there is none
+	curInterval = playIntervals.findFrom(savedFrameId);
+	if (curInterval == playIntervals.size()) { curInterval = 0; }
+}
+
+frame_id Player::getStreamLengthTo(frame_id targetFrame) const
+{
+	return playIntervals.lengthBefore(playIntervals.findStarting(targetFrame));
 }
 
 decoder_t *Player::getVideoDecoder() const
@@ -277,6 +686,32 @@ Player::Item *Player::getItemAt(frame_id frame)
 
 const Player::Item *Player::getItemAt(frame_id frame) const
 {
+	//items are not moved once inserted, so the pointer stays valid after unlock
+	waitItemsAt(frame);
+	vlc_mutex_lock(&itemsMutex);
+	const Item *res = findItem(frame);
+	vlc_mutex_unlock(&itemsMutex);
+	return res;
+}
+
+bool Player::itemsReadyAt(frame_id frame) const
+{
+	vlc_mutex_lock(&itemsMutex);
+	bool res = !itemsLoading || frame < itemsReadyTo;
+	vlc_mutex_unlock(&itemsMutex);
+	return res;
+}
+
+void Player::waitItemsAt(frame_id frame) const
+{
+	vlc_mutex_lock(&itemsMutex);
+	while (itemsLoading && frame >= itemsReadyTo) { vlc_cond_wait(&itemsCond, &itemsMutex); }
+	vlc_mutex_unlock(&itemsMutex);
+}
+
+const Player::Item *Player::findItem(frame_id frame) const //under itemsMutex
+{
+	if (items.empty()) { return nullptr; }
 	auto it = items.lower_bound(frame);
 	if (it == items.end())
 	{
@@ -294,18 +729,14 @@ const Player::Item *Player::getItemAt(frame_id frame) const
 
 Interval Player::getCurInterval() const
 {
-	if (curInterval == playIntervals.end()) { return Interval(); }
-	return curInterval->second;
+	if (curInterval >= playIntervals.size()) { return Interval(); }
+	return playIntervals[curInterval];
 }
 
 Interval Player::getNextInterval() const
 {
-	auto next = curInterval; next++;
-	if (next != playIntervals.end())
-	{
-		return next->second;
-	}
-	return Interval();
+	if (curInterval + 1 >= playIntervals.size()) { return Interval(); }
+	return playIntervals[curInterval + 1];
 }
 
 void Player::skipToCurInterval()
@@ -322,13 +753,15 @@ const Player::Item *Player::getCurItem() const
 	return getItemAt(getCurInterval().in);
 }
 
-Player::Item::Item(Player *player, const Interval &interval, 
-	es_out_t *outStream, PreloadVideoStream *preloadStream, const std::string &filename):
+Player::Item::Item(Player *player, const Interval &interval, es_out_t *outStream, 
+	PreloadVideoStream *preloadStream, const std::string &filename, const std::string &module):
 	player(player), interval(interval), valid(false)
 {
 	name = filename;
-	demux = createDemuxer(filename, outStream);
-	demux_t *preloadDemux = createDemuxer(filename, preloadStream->getWrapperStream());
+	demux = createDemuxer(filename, outStream, module);
+	//preload demuxer does not probe again, whatever module won for the main one
+	std::string preloadModule = demux ? getModule() : module;
+	demux_t *preloadDemux = createDemuxer(filename, preloadStream->getWrapperStream(), preloadModule);
 	preloader.setDemuxer(preloadDemux);
 	preloader.setVideoStream(preloadStream);
 	if (!demux || !preloadDemux) { return; }
@@ -337,7 +770,7 @@ Player::Item::Item(Player *player, const Interval &interval,
 
 void Player::Item::skip(frame_id globalFrame) const
 {
-	mtime_t time = globalToLocalFrame(globalFrame) * player->getFrameLen();
+	mtime_t time = player->getFramesTime(globalToLocalFrame(globalFrame));
 	demux_Control(demux, DEMUX_SET_TIME, time, true);
 }
 
@@ -346,37 +779,62 @@ int Player::Item::play() const
 	return demux->pf_demux(demux);
 }
 
-demux_t *Player::Item::createDemuxer(const std::string &filename, es_out_t *outStream) const
+demux_t *Player::Item::createDemuxer(const std::string &filename, es_out_t *outStream, 
+	const std::string &module) const
 {
 	stream_t *stream = vlc_stream_NewMRL(player->getVlcObj(), ("file://" + filename).c_str());
 	if (!stream) { return nullptr; }
-	return demux_New(player->getVlcObj(), "any", filename.c_str(), stream, outStream);
+	demux_t *res = demux_New(player->getVlcObj(), module.c_str(), filename.c_str(), stream, outStream);
+	if (res || module == "any") { return res; }
+	
+	//cached module may be gone (plugins changed), probe as usual
+	msg_Warn(player->getVlcObj(), "Module %s unable to open %s, probing", module.c_str(), filename.c_str());
+	vlc_stream_Delete(stream);
+	return createDemuxer(filename, outStream, "any");
+}
+
+std::string Player::Item::getModule() const
+{
+	if (!demux || !demux->p_module) { return std::string(); }
+	return module_get_object(demux->p_module);
+}
+
+mtime_t Player::Item::getDuration() const
+{
+	mtime_t length = 0;
+	if (!demux || demux_Control(demux, DEMUX_GET_LENGTH, &length) != VLC_SUCCESS) { return 0; }
+	return length;
 }
 
 int Player::play()
 {
-	if (needInitItems)
-	{
-		needInitItems = false;
-		for (auto it = items.begin(); it != items.end(); it++)
-		{
-			Item &item = (*it).second;
-			item.play();
-			item.setFirstFrameOffset(out->getLastBlockTime());
-			item.skip(item.getInterval().in);
-		}
-		out->enableOutput();
-	}
 	int res = VLC_DEMUXER_SUCCESS;
 
-	if (!intervalsSelected && !dialog->isShown()) { showDialog(); }
-	else if (intervalsSelected && dialog->isShown()) { hideDialog(); }
+	bool shown = dialogIsShown();
+	if (!intervalsSelected && !shown) { showDialog(); }
+	else if (intervalsSelected && shown) { hideDialog(); }
 	else
 	{
 		vlc_mutex_lock(&intervalsMutex);
+		takePublishedIntervals(); //between blocks, nothing of the previous intervals is in use
 		//decoder_owner_sys_t *p_owner = p_dec->p_owner;
+		
+		bool handled = getCurInterval().length() <= out->getHandledFrameId();
+		frame_id needed = handled ? getNextInterval().in : getCurInterval().in;
+		if (!itemsReadyAt(needed)) //still opened in background, waited for without the lock
+		{
+			vlc_mutex_unlock(&intervalsMutex);
+			waitItemsAt(needed);
+			return VLC_DEMUXER_SUCCESS;
+		}
+		if (seekPending && !handled)
+		{
+			Interval cur = getCurInterval();
+			seek(cur.in, getStreamFrameByGlobal(cur.in));
+		}
+		seekPending = false;
 	
-		if (getCurInterval().length() <= out->getHandledFrameId()) //interval handled, seek to next
+		if (handled) //interval handled, seek to next
 		{
 			Interval next = getNextInterval();
 			if (next.length() == 0) { res = VLC_DEMUXER_EOF; }
@@ -394,15 +852,21 @@ int Player::play()
 				else
 				{
 					Item *nextItem = getItemAt(next.in);
-					nextItem->waitPrepared();
+					bool prepared = (preparedItem == nextItem && preparedFrame == next.in);
+					if (preparedItem) { preparedItem->waitPrepared(); }
+					preparedItem = nullptr;
 					curInterval++;
 					out->resetFramesNum();
-					decoder_t *preloadDecoder = preload->getDecoder();
-					std::swap(videoDecoder->p_sys, preloadDecoder->p_sys);
-					nextItem->applyPrepared();
+					if (prepared)
+					{
+						decoder_t *preloadDecoder = preload->getDecoder();
+						std::swap(videoDecoder->p_sys, preloadDecoder->p_sys);
+						nextItem->applyPrepared();
+					}
+					else { seek(next.in, getStreamFrameByGlobal(next.in)); } //intervals changed after preload
 					res = VLC_DEMUXER_SUCCESS;
 					//skipToCurInterval();
-					msg_Dbg(obj, "Player next interval: %li", (*curInterval).first);
+					msg_Dbg(obj, "Player next interval: %li", getCurInterval().in);
 					msg_Dbg(obj, "Player dec: 0x%lx", (long unsigned)videoDecoder);
 				}
 				vlc_object_release(videoDecoder);
@@ -411,7 +875,11 @@ int Player::play()
 		else 
 		{
 			const Item *item = getCurItem();
-			if (!item) { res = VLC_DEMUXER_EOF; }
+			if (!item || !item->isValid())
+			{
+				msg_Err(obj, "Unable to play %s", item ? item->getName().c_str() : "missing item");
+				res = VLC_DEMUXER_EOF;
+			}
 			if (res != VLC_DEMUXER_EOF)
 			{
 				//msg_Dbg(obj, "Play");
@@ -459,7 +927,10 @@ int Player::control(int query, va_list args)
 
         case DEMUX_GET_POSITION:
             pf = va_arg( args, double *);
+			vlc_mutex_lock(&intervalsMutex);
+			takePublishedIntervals();
             *pf = (double)out->getTime() / getLength();
+			vlc_mutex_unlock(&intervalsMutex);
             return VLC_SUCCESS;
 
         case DEMUX_SET_POSITION:
@@ -468,7 +939,10 @@ int Player::control(int query, va_list args)
 
         case DEMUX_GET_LENGTH:
             ptime = va_arg( args, mtime_t *);
+			vlc_mutex_lock(&intervalsMutex);
+			takePublishedIntervals();
             *ptime = getLength();
+			vlc_mutex_unlock(&intervalsMutex);
             return VLC_SUCCESS;
 
         case DEMUX_GET_TITLE_INFO:
@@ -486,45 +960,35 @@ int Player::control(int query, va_list args)
 
 void Player::seek(double pos)
 {
+	vlc_mutex_lock(&intervalsMutex);
+	takePublishedIntervals();
 	const frame_id targetFrame = round(length * pos);
-	frame_id skippedFrames = 0;
-	
-	for (auto it = playIntervals.begin(); it != playIntervals.end(); it++)
+	size_t target = playIntervals.findByStream(targetFrame);
+	if (target == playIntervals.size())
 	{
-		Interval &interval = (*it).second;
-		if (skippedFrames + interval.length() < targetFrame) //found target interval
-		{
-			skippedFrames += interval.length();
-		}
-		else 
-		{
-			curInterval = it;
-			frame_id globalFrame = (targetFrame - skippedFrames) + interval.in;
-			seek(globalFrame, targetFrame);
-			return;
-		}
+		vlc_mutex_unlock(&intervalsMutex);
+		return;
 	}
+	
+	curInterval = target;
+	seekPending = false;
+	frame_id globalFrame = (targetFrame - playIntervals.lengthBefore(target)) + playIntervals.getIn(target);
+	vlc_mutex_unlock(&intervalsMutex);
+	seek(globalFrame, targetFrame); //item may still be loading, waited for without the lock
 }
 
 void Player::seek(frame_id globalFrame, frame_id streamFrame)
 {
 	Item *item = getItemAt(globalFrame);
-	if (!item) return;
+	if (!item || !item->isValid()) return;
 	
 	item->skip(globalFrame);
-	out->setTime(streamFrame * getFrameLen());
+	out->setTime(getFramesTime(streamFrame));
 }
 
 frame_id Player::getStreamFrameByGlobal(frame_id frame) const
 {
-	frame_id streamFrames = 0;
-	for (auto it = playIntervals.begin(); it != playIntervals.end(); it++)
-	{
-		const Interval &interval = (*it).second;
-		if (interval.in > frame) { break; }
-		if (interval.out <= frame) { streamFrames += interval.length(); }
-	}
-	return streamFrames;
+	return playIntervals.toStream(frame);
 }
 
 void Player::setPause(bool pause) const
@@ -535,7 +999,7 @@ void Player::setPause(bool pause) const
 vlc_object_t *print;
 void Player::Item::prepare(frame_id frame)
 {
-	mtime_t time = globalToLocalFrame(frame) * player->getFrameLen();
+	mtime_t time = player->getFramesTime(globalToLocalFrame(frame));
 	msg_Dbg(player->getVlcObj(), "Prepare frame %li (time %li)", frame, time);
 	print = player->getVlcObj();
 	preloader.load(time);
@@ -3,22 +3,38 @@
 
 #include <string>
 #include <map>
+#include <vector>
+#include <atomic>
 #include <vlc_common.h>
 #include "ntff_feature.h"
+#include "ntff_intervals.h"
+#include "ntff_timecode.h"
+#include "ntff_stats.h"
+#include "ntff_log.h"
 
 namespace Ntff {
 
 class OutStream;
 class PreloadVideoStream;
 class Dialog;
+class Project;
+class FileWatcher;
+class MediaCache;
+class Selection;
+class Filter;
+struct MediaEntry;
 
 class Player
 {
 	class Item;
 public:
-	Player(demux_t *obj, FeatureList *featureList, double fps);
+	Player(demux_t *obj, const FrameRate &frameRate);
 	~Player();
+	static Player *create(demux_t *demux, Project *project);
 	bool isValid() const;
+	void publishStats(double openTime);
+	bool selectPreset(const std::string &beginAction, const std::string &rules);
+	bool selectFilter(const std::string &text);
 	void addFile(const Interval &interval, const std::string &filename);
 	int play();
 	int control(int query, va_list args);
@@ -28,48 +44,89 @@ public:
 	bool frameIsInPlayInterval(frame_id frame) const;
 	vlc_object_t *getVlcObj() const { return (vlc_object_t *)obj; }
 	demux_t *getDemuxer() const { return obj; }
-	double getFrameLen() const { return 1000000 / fps; }
+	mtime_t getFramesTime(frame_id frames) const { return frameRate.framesToTime(frames); }
 	int getFrameId(mtime_t timeInItem) const;
 	frame_id getCurIntervalFirstFrame() const;
 	void setIntervalsSelected();
 	void showDialog();
 	void hideDialog();
+	bool dialogIsShown();
 	frame_id getGlobalFrame() const;
-	mtime_t getLength() const { return length * getFrameLen(); }
-	void lockIntervals(bool lock);
-	void resetIntervals(bool empty);
-	void modifyIntervals(bool add, const Feature *f, int8_t minIntensity, int8_t maxIntensity, bool affectUnmarked);
-	void recalcLength();
-	void updateCurrentInterval();
+	mtime_t getLength() const { return getFramesTime(length); }
+	void lockFeatures(bool lock);
+	frame_id getWholeDuration() const { return wholeDuration; }
+	void publishPlayIntervals(IntervalSet *intervals); //taken by demux thread, owned by player
 	frame_id getStreamLengthTo(frame_id targetFrame) const;
 	decoder_t *getVideoDecoder() const;
 private:
 	demux_t *obj;
 	FeatureList *featureList;
 	std::map<frame_id, Item> items;
+	mutable vlc_mutex_t itemsMutex;
+	mutable vlc_cond_t itemsCond;
+	vlc_thread_t itemsThread;
+	bool itemsLoading; //items from itemsReadyTo are still being opened
+	bool itemsCancel;
+	frame_id itemsReadyTo;
+	std::vector<MediaEntry> *pendingEntries;
 	OutStream *out;
 	PreloadVideoStream *preload;
 	vlc_mutex_t intervalsMutex;
-	std::map<frame_id, Interval> playIntervals;
-	std::map<frame_id, Interval>::iterator curInterval;
+	//intervals of features change on reload, taken after intervalsMutex;
+	//held while references to unions and unmarked frames of features are in use
+	vlc_mutex_t featuresMutex;
+	IntervalSet playIntervals;
+	std::atomic<IntervalSet *> publishedIntervals; //next play intervals, not taken yet
+	size_t curInterval; //index in playIntervals, playIntervals.size() if none
+	bool seekPending; //curInterval was changed by a reload, play() seeks to it
 	frame_id length;
 	frame_id wholeDuration;
 	frame_id savedFrameId;
 	bool intervalsSelected;
 	Dialog *dialog;
-	bool needInitItems;
-	double fps;
+	vlc_mutex_t dialogMutex;
+	Project *project;
+	FileWatcher *watcher;
+	vlc_thread_t featuresThread;
+	bool featuresLoading;
+	FrameRate frameRate;
+	LoadStats stats;
+	Item *preparedItem;
+	frame_id preparedFrame;
+	Selection *presetSelection; //headless selection from rules, reapplied on project reload
+	Filter *presetFilter; //the same from an expression, used instead of rules
+	MediaCache *mediaCache;
+	Log::Handler logHandler; //of the thread opening the input, set in threads of the player
+	void *logData;
 	
+	void setDuration(frame_id duration);
+	Item createItem(const Interval &interval, const std::string &filename);
+	void insertItem(const Item &item);
+	void loadItems(const std::vector<MediaEntry> &entries);
+	void stopLoadingItems();
+	const Item *findItem(frame_id frame) const;
 	void skipToCurInterval();
 	const Item *getCurItem() const;
 	Item *getItemAt(frame_id frame);
-	const Item *getItemAt(frame_id frame) const;
+	const Item *getItemAt(frame_id frame) const; //waits until item is opened
+	bool itemsReadyAt(frame_id frame) const; //getItemAt does not wait
+	void waitItemsAt(frame_id frame) const;
 	Interval getCurInterval() const;
 	Interval getNextInterval() const;
+	void loadFeatures(Project *project);
+	void materializeFeatures();
+	Dialog *getDialog();
 	void seek(frame_id globalFrame, frame_id streamFrame);
 	frame_id getStreamFrameByGlobal(frame_id frame) const;
+	bool takePublishedIntervals();
+	void recalcLength();
+	void updateCurrentInterval();
 	mtime_t getCurOffset() const;
 	void prepareNextInterval();
+	void reloadProject();
+	void patchIntervals(IntervalSet &intervals); //swapped with the current ones
+	void setPreset(Selection *selection, Filter *filter);
+	void applyPreset(IntervalSet &intervals) const;
 };
 
 class Preloader
@@ -93,11 +150,14 @@ class Player::Item
 {
 public:
 	Item(){}
-	Item(Player *player, const Interval &interval, 
-		es_out_t *outStream, PreloadVideoStream *preloadStream, const std::string &filename);
+	Item(Player *player, const Interval &interval, es_out_t *outStream, 
+		PreloadVideoStream *preloadStream, const std::string &filename, const std::string &module);
 	
 	const std::string &getName() const { return name; }
+	std::string getModule() const;
+	mtime_t getDuration() const;
 	bool isValid() const { return valid; }
+	int getDemuxersNum() const { return (demux != nullptr) + (preloader.getDemuxer() != nullptr); }
 	void skip(frame_id globalFrame) const;
 	int play() const;
 	const Interval &getInterval() const { return interval; }
@@ -115,7 +175,7 @@ private:
 	std::string name;
 	mtime_t firstFrameOffset; //if videofile has B-frames, first frame will have pts != 0
 	Preloader preloader;
-	demux_t *createDemuxer(const std::string &filename, es_out_t *outStream) const;
+	demux_t *createDemuxer(const std::string &filename, es_out_t *outStream, const std::string &module) const;
 };
 
 }
@@ -1,29 +1,60 @@
 #include "ntff_project.h"
 #include "ntff_feature.h"
-#include "ntff_player.h"
-#include <list>
+#include "ntff_cache.h"
+#include "ntff_resolver.h"
+#include "ntff_mmap.h"
+#include "ntff_xml.h"
+#include "ntff_log.h"
+#include "ntff_tokens.h"
+#include "ntff_arena.h"
+#include "ntff_sidecar.h"
+#include <unordered_map>
+#include <unordered_set>
 #include <cstdio>
+#include <cstring>
+#include <cmath>
 #include <sstream>
 #include <filesystem>
-#include <vlc_common.h>
-#include <vlc_xml.h>
+#include <algorithm>
+#include <charconv>
+#include <cctype>
+#include <sys/stat.h>
 
 namespace Ntff {
 
-vlc_object_t *Project::obj;
+//nanoseconds, as MappedFile::getMtime, 0 if there is no file
+static int64_t getFileMtime(const std::string &file)
+{
+	struct stat st;
+	if (stat(file.c_str(), &st) != 0) { return 0; }
+	return (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+//as atoi, for text views of the reader
+static int toInt(std::string_view text)
+{
+	size_t pos = 0;
+	while (pos < text.size() && isspace((unsigned char)text[pos])) { pos++; }
+	if (pos < text.size() && text[pos] == '+') { pos++; }
+	int res = 0;
+	std::from_chars(text.data() + pos, text.data() + text.size(), res);
+	return res;
+}
+
+//model classes live in Project arena, strings are interned there
 
 class Producer
 {
 	friend std::ostream &operator<<(std::ostream &out, Producer const &producer);
 public:
-	 Producer(xml_reader_t *reader);
+	 Producer(XmlReader *reader, Arena &arena);
 	 bool isFeature() const { return feature; }
-	 const std::string &getName() const { return id; }
-	 const std::string &getResource() const { return resource; }
-	 bool updatePath(const std::string &parentPath);
+	 const char *getName() const { return id; }
+	 const char *getResource() const { return resource; }
+	 bool updatePath(const PathResolver &resolver, Arena &arena);
 private:
-	 std::string id;
-	 std::string resource;
+	 const char *id;
+	 const char *resource;
 	 bool feature;
 };
 
@@ -33,14 +64,14 @@ class Entry
 public:
 	Entry(frame_id in, frame_id out, int8_t intensity, const char *producer): 
 		interval(in, out, intensity), producer(producer), producerPtr(nullptr) {}
-	const std::string &getProducerName() const { return producer; }
+	const char *getProducerName() const { return producer; }
 	void setProducer(Producer *producer) { producerPtr = producer; }
-	bool updatePath(const std::string &parentPath);
+	Producer *getProducer() const { return producerPtr; }
 	const Interval &getInterval() const { return interval; }
-	const std::string &getResource() const { return producerPtr->getResource(); }
+	const char *getResource() const { return producerPtr->getResource(); }
 private:
 	Interval interval;
-	std::string producer;
+	const char *producer;
 	Producer *producerPtr;
 };
 
@@ -48,34 +79,39 @@ class  Playlist
 {
 	friend std::ostream &operator<<(std::ostream &out, Playlist const &playlist);
 public:
-	 Playlist(xml_reader_t *reader, double fps);
+	 Playlist(XmlReader *reader, const FrameRate &frameRate, Arena &arena);
 	 bool isEmpty() { return entries.empty(); }
 	 bool isFeature() const { return feature; }
-	 void bindProducers(const std::list<Producer *>&producers);
-	 bool updatePath(const std::string &parentPath);
-	 std::string getName()const {return id;}
-	 const std::list<Entry> &getEntries() const { return entries; }
+	 bool bindProducers(const std::unordered_map<std::string_view, Producer *> &producerIndex);
+	 const char *getName() const { return id; }
+	 const ArenaArray<Entry> &getEntries() const { return entries; }
 private:
-	 std::string id;
-	 std::list<Entry> entries;
+	 const char *id;
+	 ArenaArray<Entry> entries;
 	 bool feature;
-	 void skipToEnd(xml_reader_t *reader) const;
-	 frame_id parseTime(const char *time, double fps) const; // parse frame id from HH:MM:SS.MS format
 };
 
 class FeatureTrack
 {
 public:
-	FeatureTrack(xml_reader_t *reader);
-	bool isValid() const { return feature != nullptr;}
-	Feature *getFeature() const { return feature; }
+	FeatureTrack(XmlReader *reader, Arena &arena);
+	bool isValid() const { return feature; }
+	const char *getName() const { return id; }
+	const char *getFeatureName() const { return name; }
+	Feature *createFeature() const;
 	void setPlaylist(Playlist *p) { playlist = p; }
 	const Playlist *getPlaylist() const { return playlist; }
-	const std::list<std::string> &getPlaylists() const { return playlists; }
+	const ArenaArray<const char *> &getPlaylists() const { return playlists; }
 private:
-	Feature *feature;
+	const char *id;
+	const char *name;
+	const char *description;
+	const char *recAction;
+	const char *recEq;
+	int8_t recIntensity;
+	bool feature;
 	Playlist *playlist;
-	std::list<std::string> playlists;
+	ArenaArray<const char *> playlists;
 };
 
 std::ostream &operator<<(std::ostream &out, Entry const &entry) 
@@ -108,387 +144,371 @@ std::ostream &operator<<(std::ostream &out, Producer const &producer)
 	return out;
 }
 
-Playlist::Playlist(xml_reader_t *reader, double fps)
+Playlist::Playlist(XmlReader *reader, const FrameRate &frameRate, Arena &arena): id(""), feature(false)
 {
-	if (xml_ReaderIsEmptyElement(reader)) { return; }
+	if (reader->isEmptyElement()) { return; }
 	
-	const char *value;
-	xml_ReaderNextAttr(reader, &value);
-	id = std::string(value); 
+	const char *value, *attr;
+	while ((attr = reader->nextAttr(&value)) != NULL)
+	{
+		if (tokenize(attr) == Token::Id) { id = arena.intern(value); }
+	}
 	
-	if (id == "main_bin") { skipToEnd(reader); return; }
+	if (strcmp(id, "main_bin") == 0) { Project::skipToEnd(reader, 1); return; }
 	
-	const char *nodeC;
-	int type = xml_ReaderNextNode(reader, &nodeC);
-	bool empty = xml_ReaderIsEmptyElement(reader);
-	std::string node(nodeC);
+	Token node;
+	int type = Project::nextNode(reader, node);
+	bool open = Project::isOpen(reader, type);
 #ifdef DEBUG_PROJECT_PARSING
-	msg_Dbg(Project::getVlcObj(), "~~~~~~Project playlist: id = %s, type = %i, node = %s, empty = %i", 
-		id.c_str(), type, nodeC, empty);
+	Log::dbg("~~~~~~Project playlist: id = %s, type = %i, node = %i, open = %i", 
+		id, type, (int)node, open);
 #endif	
-	if (node != "blank" && node != "entry")
+	if (node != Token::Blank && node != Token::Entry)
 	{
-		skipToEnd(reader);
+		if (type != XmlReader::EndElem) { Project::skipToEnd(reader, open ? 2 : 1); }
 		return;
 	}
 	
+	std::vector<Entry> parsed;
+	const char *producer;
 	frame_id prevEndFrame = 0;
-	do
+	while (type > XmlReader::None && !(type == XmlReader::EndElem && node == Token::Playlist))
 	{
-		if (node == "blank")
+		if (node == Token::Blank && type == XmlReader::StartElem)
 		{
-			const char *length;
-			xml_ReaderNextAttr(reader, &length);
-			prevEndFrame += parseTime(length, fps);
+			while ((attr = reader->nextAttr(&value)) != NULL)
+			{
+				if (tokenize(attr) == Token::Length) { prevEndFrame += frameRate.parseTime(value); }
+			}
 		}
-		else if (node == "entry")
+		else if (node == Token::Entry && type == XmlReader::StartElem)
 		{
-			const char *producer;
-			const char *in;
-			const char *out;
-			xml_ReaderNextAttr(reader, &producer);
-			xml_ReaderNextAttr(reader, &in);
-			xml_ReaderNextAttr(reader, &out);
+			producer = "";
+			frame_id duration = 0;
+			while ((attr = reader->nextAttr(&value)) != NULL)
+			{
+				switch (tokenize(attr))
+				{
+					case Token::Producer: producer = arena.intern(value); break;
+					case Token::Out: duration = frameRate.parseTime(value) + 1; break;
+					default: break;
+				}
+			}
 			
 			frame_id beginFrame = prevEndFrame;
-			frame_id endFrame = prevEndFrame + parseTime(out, fps) + 1;
+			frame_id endFrame = prevEndFrame + duration;
 			prevEndFrame = endFrame;
 			int8_t intensity = 0;
 			
-			if (!empty)
+			if (open)
 			{
-				const char *inodeC;
-				type = xml_ReaderNextNode(reader, &inodeC);
-				empty = xml_ReaderIsEmptyElement(reader);
-				std::string inode(inodeC);
+				Token inode;
+				type = Project::nextNode(reader, inode);
+				bool iopen = Project::isOpen(reader, type);
 				
+				while (type > XmlReader::None && !(type == XmlReader::EndElem && inode == Token::Entry))
+				{
 #ifdef DEBUG_PROJECT_PARSING		
-		msg_Dbg(Project::getVlcObj(), "~~~~~~~~Project playlist: id = %s, type = %i, node = %s, empty = %i", 
-			id.c_str(), type, inode.c_str(), empty);
+					Log::dbg("~~~~~~~~Project playlist: id = %s, type = %i, node = %i, open = %i", 
+						id, type, (int)inode, iopen);
 #endif
-				do
-				{
-					if (inode == "property" && !empty)
+					if (inode == Token::Property && iopen && 
+						Project::propertyName(reader) == Token::KdenliveIntensity)
 					{
-						const char *pName;
-						xml_ReaderNextAttr(reader, &pName);
-						if (std::string(pName) == "kdenlive:intensity")
-						{
-							const char *data;
-							xml_ReaderNextNode(reader, &data);
-							intensity = atoi(data);
-						}				
+						std::string_view data;
+						iopen = !Project::readText(reader, data);
+						intensity = toInt(data);
 					}
-					type = Project::nextSibling(reader, inode, empty, inode);
-					empty = xml_ReaderIsEmptyElement(reader);
-				} while (!(type == XML_READER_ENDELEM && inode == "entry"));
-				empty = true;
+					type = Project::nextSibling(reader, iopen, inode);
+					iopen = Project::isOpen(reader, type);
+				}
+				open = false;
 			}
 			
-			entries.push_back(Entry(beginFrame, endFrame, intensity, producer));
+			parsed.push_back(Entry(beginFrame, endFrame, intensity, producer));
 		}
 		
-		type = Project::nextSibling(reader, node, empty, node);
-		empty = xml_ReaderIsEmptyElement(reader);
+		type = Project::nextSibling(reader, open, node);
+		open = Project::isOpen(reader, type);
 #ifdef DEBUG_PROJECT_PARSING		
-		msg_Dbg(Project::getVlcObj(), "~~~~~~Project playlist: id = %s, type = %i, node = %s, empty = %i", 
-			id.c_str(), type, node.c_str(), xml_ReaderIsEmptyElement(reader));
+		Log::dbg("~~~~~~Project playlist: id = %s, type = %i, node = %i, open = %i", 
+			id, type, (int)node, open);
 #endif
 	}
-	while (!(type == XML_READER_ENDELEM && node == "playlist"));
+	entries = arena.copy(parsed);
 }
 
-void Playlist::bindProducers(const std::list<Producer *> &producers)
+bool Playlist::bindProducers(const std::unordered_map<std::string_view, Producer *> &producerIndex)
 {
 	feature = false;
+	bool res = true;
+	std::unordered_set<const char *> unresolved; //names are interned
 	for (Entry &e: entries)
 	{
-		for (Producer *p: producers)
+		auto it = producerIndex.find(e.getProducerName());
+		if (it == producerIndex.end())
 		{
-			if (p->getName() == e.getProducerName())
+			if (unresolved.insert(e.getProducerName()).second)
 			{
-				e.setProducer(p);
-				if (p->isFeature()) { feature = true; }
-				break;
+				Log::err("Playlist %s: unresolved producer id \"%s\"", id, e.getProducerName());
 			}
+			res = false;
+			continue;
 		}
-	}
-}
-
-bool Playlist::updatePath(const std::string &parentPath)
-{
-	bool res = true;
-	for (Entry &e: entries)
-	{
-		res &= e.updatePath(parentPath);
+		
+		Producer *p = it->second;
+		e.setProducer(p);
+		if (p->isFeature()) { feature = true; }
 	}
 	return res;
 }
 
-void Playlist::skipToEnd(xml_reader_t *reader) const
+FeatureTrack::FeatureTrack(XmlReader *reader, Arena &arena): 
+	id(""), name(""), description(""), recAction(""), recEq(""), recIntensity(0), feature(false), playlist(nullptr)
 {
-	const char *node;
-	int type;
-	while (true)
+	bool empty = reader->isEmptyElement(); //before attributes, reader moves to them
+	const char *value, *attr;
+	while ((attr = reader->nextAttr(&value)) != NULL)
 	{
-		type = xml_ReaderNextNode(reader, &node);
-#ifdef DEBUG_PROJECT_PARSING
-		msg_Dbg(Project::getVlcObj(), "~~~~~~~~Project skip:     type = %i, node = %s, empty = %i", 
-			type, node, xml_ReaderIsEmptyElement(reader));
-#endif
-		if (type == XML_READER_ENDELEM && std::string(node) == "playlist") { return; }
+		if (tokenize(attr) == Token::Id) { id = arena.intern(value); }
 	}
-}
-
-frame_id Playlist::parseTime(const char *time, double fps) const
-{
-	unsigned hours, min, sec, msec;
-	int num = sscanf(time, "%d:%d:%d.%d", &hours, &min, &sec, &msec);
-	if (num != 4) return 0;
-
-	//copied from mlt_property.c, function time_clock_to_frames
-	frame_id frame = floor( fps * hours * 3600 ) + floor( fps * min * 60 ) + lrint( fps * (sec + msec/1000.));
-
-	return frame;
-}
-
-FeatureTrack::FeatureTrack(xml_reader_t *reader): feature(nullptr), playlist(nullptr)
-{
-	if (xml_ReaderIsEmptyElement(reader)) { return; }
-	
-	const char *nodeC;
-	int type = xml_ReaderNextNode(reader, &nodeC);
-	bool empty = xml_ReaderIsEmptyElement(reader);
-	std::string node(nodeC);
+	if (empty) { return; }
 	
-	std::string name, description, recAction, recEq;
-	int recIntensity = 0;
-	bool isFeature = false;
+	Token node;
+	int type = Project::nextNode(reader, node);
+	bool open = Project::isOpen(reader, type);
+	std::vector<const char *> playlistNames;
 	
-	do
+	while (type > XmlReader::None && !(type == XmlReader::EndElem && node == Token::Tractor))
 	{
-		if (node == "property" && !empty)
+		if (node == Token::Property && open)
 		{
-			const char *pName;
-			xml_ReaderNextAttr(reader, &pName);
-			std::string property(pName);
+			Token property = Project::propertyName(reader);
 			
-			const char *data;
-			xml_ReaderNextNode(reader, &data);
+			std::string_view data;
+			open = !Project::readText(reader, data);
 			
-			if (property == "kdenlive:feature_rec_intensity")
-			{
-				recIntensity = atoi(data);
-			}
-			else if (property == "kdenlive:track_name")
-			{
-				name = std::string(data);
-			}
-			else if (property == "kdenlive:feature_description")
+			switch (property)
 			{
-				description = std::string(data);
-			}
-			else if (property == "kdenlive:feature_track")
-			{
-				isFeature = true;
-			}
-			else if (property == "kdenlive:feature_rec_action")
-			{
-				recAction = std::string(data);
-			}
-			else if (property == "kdenlive:feature_rec_eq")
-			{
-				recEq = std::string(data);
+				case Token::KdenliveFeatureRecIntensity: recIntensity = toInt(data); break;
+				case Token::KdenliveTrackName: name = arena.intern(data); break;
+				case Token::KdenliveFeatureDescription: description = arena.intern(data); break;
+				case Token::KdenliveFeatureTrack: feature = true; break;
+				case Token::KdenliveFeatureRecAction: recAction = arena.intern(data); break;
+				case Token::KdenliveFeatureRecEq: recEq = arena.intern(data); break;
+				default: break;
 			}
 			
 #ifdef DEBUG_PROJECT_PARSING		
-		msg_Dbg(Project::getVlcObj(), "~~~~~~Project track: property = %s, data = %s", 
-			property.c_str(), data);
+			Log::dbg("~~~~~~Project track: property = %i, data = %.*s", (int)property, (int)data.size(), data.data());
 #endif
 		}
-		else if (node == "track")
+		else if (node == Token::Track && type == XmlReader::StartElem)
 		{
-			const char *value, *attr;
-			while ((attr = xml_ReaderNextAttr(reader, &value)) != NULL)
+			while ((attr = reader->nextAttr(&value)) != NULL)
 			{
-				if (std::string(attr) == "producer") { playlists.push_back(value); }
+				if (tokenize(attr) == Token::Producer) { playlistNames.push_back(arena.intern(value)); }
 			}
 		}	
 		
 #ifdef DEBUG_PROJECT_PARSING		
-		msg_Dbg(Project::getVlcObj(), "~~~~~~Project track: node = %s, empty = %i", 
-			node.c_str(), empty);
+		Log::dbg("~~~~~~Project track: node = %i, open = %i", (int)node, open);
 #endif
-		type = Project::nextSibling(reader, node, empty, node);
-		empty = xml_ReaderIsEmptyElement(reader);
+		type = Project::nextSibling(reader, open, node);
+		open = Project::isOpen(reader, type);
 	}
-	while (!(type == XML_READER_ENDELEM && node == "tractor"));
 	
-	if (isFeature)
-	{
-		feature  = new Feature(name, description, recAction, recEq, recIntensity);
-	}
+	playlists = arena.copy(playlistNames);
 	
 #ifdef DEBUG_PROJECT_PARSING		
-		msg_Dbg(Project::getVlcObj(), "~~~~~~~~~~~~~~FeatureTrack: %s %s %i %i", 
-			name.c_str(), description.c_str(), recMin, recMax);
+		Log::dbg("~~~~~~~~~~~~~~FeatureTrack: %s %s %i", name, description, recIntensity);
 #endif
 }
 
-Producer::Producer(xml_reader_t *reader)
+Feature *FeatureTrack::createFeature() const
 {
-	feature = false;
-	if (xml_ReaderIsEmptyElement(reader)) { return; }
+	Feature *res = new Feature(name, description, recAction, recEq, recIntensity);
+	if (!playlist) { return res; }
+	for (const Entry &entry: playlist->getEntries())
+	{
+		res->appendInterval(entry.getInterval());
+	}
+	return res;
+}
+
+Producer::Producer(XmlReader *reader, Arena &arena): id(""), resource(""), feature(false)
+{
+	if (reader->isEmptyElement()) { return; }
 	
 	const char *value, *attr;
-	while ((attr = xml_ReaderNextAttr(reader, &value)) != NULL)
+	while ((attr = reader->nextAttr(&value)) != NULL)
 	{
-		if (std::string(attr) == "id") { id = std::string(value); break; }
+		if (tokenize(attr) == Token::Id) { id = arena.intern(value); break; }
 	}
-	if (id.empty()) return;
+	if (!*id) { Project::skipToEnd(reader, 1); return; }
 	
-	const char *nodeC;
-	int type = xml_ReaderNextNode(reader, &nodeC);
-	bool empty = xml_ReaderIsEmptyElement(reader);
-	std::string node(nodeC);
+	Token node;
+	int type = Project::nextNode(reader, node);
+	bool open = Project::isOpen(reader, type);
 	
-	do
+	while (type > XmlReader::None && !(type == XmlReader::EndElem && node == Token::Producer))
 	{
-		if (node == "property")
+		if (node == Token::Property && open)
 		{
-			const char *pName;
-			xml_ReaderNextAttr(reader, &pName);
-			std::string property(pName);
-			
-			if (property == "resource")
+			Token property = Project::propertyName(reader);
+			std::string_view data;
+			if (property == Token::Resource)
 			{
-				const char *resourceC;
-				xml_ReaderNextNode(reader, &resourceC);
-				resource = std::string(resourceC);
+				open = !Project::readText(reader, data);
+				resource = arena.intern(data);
 			}
-			else if (property == "kdenlive:clipname" && !empty)
+			else if (property == Token::KdenliveClipname)
 			{
-				const char *clipname;
-				xml_ReaderNextNode(reader, &clipname);
-				resource = std::string(clipname);
-				if (resource == "feature_binclip") { feature = true; }
+				open = !Project::readText(reader, data);
+				resource = arena.intern(data);
+				if (strcmp(resource, "feature_binclip") == 0) { feature = true; }
 			}
 		}
 		
-		type = Project::nextSibling(reader, node, empty, node);
-		empty = xml_ReaderIsEmptyElement(reader);
+		type = Project::nextSibling(reader, open, node);
+		open = Project::isOpen(reader, type);
 #ifdef DEBUG_PROJECT_PARSING		
-		msg_Dbg(Project::getVlcObj(), "~~~~~~Project producer: id = %s, type = %i, node = %s, empty = %i", 
-			id.c_str(), type, node.c_str(), xml_ReaderIsEmptyElement(reader));
+		Log::dbg("~~~~~~Project producer: id = %s, type = %i, node = %i, open = %i", 
+			id, type, (int)node, open);
 #endif
 	}
-	while (!(type == XML_READER_ENDELEM && node == "producer"));
 }
 
-bool Producer::updatePath(const std::string &parentPath)
+bool Producer::updatePath(const PathResolver &resolver, Arena &arena)
 {
-	std::filesystem::path resourcePath(resource);
-	
-	resource = parentPath/resourcePath.filename();
-	if (FILE *file = fopen(resource.c_str(), "r")) 
-	{
-		fclose(file);
-		return true;
-	}
-	
-	std::filesystem::path resDirectory;
-	for(const std::filesystem::path &e: resourcePath.parent_path())
+	std::string resolved;
+	if (!resolver.resolve(resource, resolved))
 	{
-		resDirectory = e;
-	}
-	
-	resource = parentPath/resDirectory/resourcePath.filename();
-	if (FILE *file = fopen(resource.c_str(), "r")) 
-	{
-		fclose(file);
-		return true;
+		Log::err("Media file %s (producer %s) not found", resource, id);
+		return false;
 	}
-	
-	return false;
+	resource = arena.intern(resolved);
+	return true;
 }
 
-Project::Project(vlc_object_t *nobj, const char *file, stream_t *stream)
+Project::Project(const std::string &file, const std::function<XmlReader *()> &createReader, bool useCache)
 {
-	obj = nobj;
 	valid = false;
 	mainPlaylist = nullptr;
+	cache = nullptr;
+	sidecar = nullptr;
+	arena = new Arena();
+	sourceFile = file;
+	loadMtime = 0;
 
 	if (std::filesystem::path(file).extension() != ".kdenlive") return;
 	
-	xml_reader_t *reader = xml_ReaderCreate(obj, stream);
+	PhaseTimer timer(stats.cacheTime);
+	if (useCache)
+	{
+		cache = new ProjectCache(file);
+		if (cache->isValid())
+		{
+			frameRate = cache->getFrameRate();
+			stats.fromCache = true;
+			stats.entries = cache->getEntriesNum();
+			valid = true;
+			Log::dbg("Project loaded from cache %s", ProjectCache::pathFor(file).c_str());
+			loadSidecar(file);
+			return;
+		}
+		delete cache;
+		cache = nullptr;
+	}
+	
+	timer.next(stats.parseTime);
+	loadMtime = getFileMtime(file); //sections are indexed later only if file is the same
+	XmlReader *reader = createReader();
 	if (!reader) return;
 	
-	const char *nodeC;
+	Token node;
 	int type;
-	std::string node;
 	do
 	{
-		type = xml_ReaderNextNode(reader, &nodeC);
-		node = std::string(nodeC);
+		type = nextNode(reader, node);
+		if (type <= XmlReader::None) { delete reader; return; }
 	}
-	while (node != "profile");
-	bool isEmpty = xml_ReaderIsEmptyElement(reader);
+	while (!(type == XmlReader::StartElem && node == Token::Profile));
+	bool open = isOpen(reader, type);
 	
 	const char *value, *attr;
-	int frame_rate_num = 0;
-	int frame_rate_den = 1;
-	while ((attr = xml_ReaderNextAttr(reader, &value)) != NULL)
+	while ((attr = reader->nextAttr(&value)) != NULL)
 	{
-		if (std::string(attr) == "frame_rate_num") { frame_rate_num = atoi(value); }
-		else if (std::string(attr) == "frame_rate_den") { frame_rate_den = atoi(value); }
+		switch (tokenize(attr))
+		{
+			case Token::FrameRateNum: frameRate.num = atoi(value); break;
+			case Token::FrameRateDen: frameRate.den = atoi(value); break;
+			default: break;
+		}
+	}
+	if (!frameRate.isValid())
+	{
+		Log::err("Invalid project frame rate %d/%d", frameRate.num, frameRate.den);
+		delete reader;
+		return;
 	}
-	fps = (float)frame_rate_num / frame_rate_den;
+	loadSidecar(file);
 	
-	while (!(type == XML_READER_ENDELEM && node == "mlt"))
+	while (type > XmlReader::None && !(type == XmlReader::EndElem && node == Token::Mlt))
 	{
-		type = nextSibling(reader, node, isEmpty || type == XML_READER_ENDELEM, node);
-		
-		isEmpty = xml_ReaderIsEmptyElement(reader);
+		type = nextSibling(reader, open, node);
+		open = isOpen(reader, type);
 #ifdef DEBUG_PROJECT_PARSING
-		msg_Dbg(obj, "~~~~Project type = %i, node = %s, empty = %i", 
-			type, node.c_str(), isEmpty);
+		Log::dbg("~~~~Project type = %i, node = %i, open = %i", type, (int)node, open);
 #endif
+		if (type != XmlReader::StartElem) { continue; }
 		
-		if (node == "playlist")
+		if (node == Token::Playlist)
 		{
-			Playlist *p = new Playlist(reader, fps);
+			Playlist *p = arena->create<Playlist>(reader, frameRate, *arena);
 			if (!p->isEmpty())
 			{
 				playlists.push_back(p);
+				playlistIndex.emplace(p->getName(), p);
 			}
-			else { delete p; }
-			type = XML_READER_ENDELEM;
+			open = false;
 		}
-		else if (node == "producer")
+		else if (node == Token::Producer)
 		{
-			Producer *p = new Producer(reader);
+			Producer *p = arena->create<Producer>(reader, *arena);
 			producers.push_back(p);
-			type = XML_READER_ENDELEM;
+			if (*p->getName()) { producerIndex.emplace(p->getName(), p); }
+			open = false;
 		}
-		else if (node == "tractor")
+		else if (node == Token::Tractor)
 		{
-			FeatureTrack *f = new FeatureTrack(reader);
+			FeatureTrack *f = arena->create<FeatureTrack>(reader, *arena);
 			if (f->isValid()) { tracks.push_back(f); }
-			type = XML_READER_ENDELEM;
+			open = false;
 		}
 	}
 	
+	stats.nodes = reader->getNodesNum();
+	stats.producers = producers.size();
+	stats.playlists = playlists.size();
+	stats.tracks = tracks.size();
+	
+	timer.next(stats.bindTime);
 	valid = bindProducers();
 	valid &= bindTracks();
 	if (mainPlaylist)
 	{
-		valid &= mainPlaylist->updatePath(std::filesystem::path(file).parent_path());
+		stats.entries = mainPlaylist->getEntries().size();
+		timer.next(stats.pathsTime);
+		valid &= updatePaths(std::filesystem::path(file).parent_path());
 	}
+	stats.modelBytes = arena->getUsed();
 	
 	
+#ifdef DEBUG_PROJECT_PARSING
 	std::stringstream ss;
 	ss << std::endl;
-	ss << "FPS: " << fps << std::endl;
+	ss << "FPS: " << frameRate.num << "/" << frameRate.den << std::endl;
 	for (Playlist *p: playlists)
 	{
 		ss << *p;
@@ -499,66 +519,404 @@ Project::Project(vlc_object_t *nobj, const char *file, stream_t *stream)
 		ss << *p << std::endl;
 	}
 	
-	msg_Dbg(obj, "%s", ss.str().c_str());
+	Log::dbg("%s", ss.str().c_str());
+#endif
+	
+	delete reader;
 	
-	xml_ReaderDelete(reader);
+	if (valid && useCache) { storeCache(file); }
 }
 
-FeatureList *Project::generateFeatureList() const
+Project::~Project()
 {
-	FeatureList *flist = new FeatureList();
-	
+	delete cache;
+	delete sidecar;
+	delete arena; //whole model at once
+}
+
+void Project::storeCache(const std::string &file) const
+{
+	ProjectCache::Writer writer(frameRate);
+	for (const Entry &entry: mainPlaylist->getEntries())
+	{
+		writer.addEntry(entry.getInterval(), entry.getResource());
+	}
 	for (FeatureTrack *track: tracks)
 	{
-		Feature *feature = track->getFeature();
-		for (const Entry &entry: track->getPlaylist()->getEntries())
-		{
-			feature->appendInterval(entry.getInterval());
-		}
-		flist->push_back(feature);
+		Feature *feature = track->createFeature();
+		writer.addFeature(*feature);
+		for (const Interval &interval: feature->getIntervals()) { writer.addFeatureInterval(interval); }
+		delete feature;
 	}
 	
+	if (!writer.write(file))
+	{
+		Log::dbg("Unable to write project cache %s", ProjectCache::pathFor(file).c_str());
+	}
+}
+
+void Project::loadSidecar(const std::string &file)
+{
+	sidecar = new FeatureSidecar(file, frameRate);
+	if (!sidecar->isValid())
+	{
+		delete sidecar;
+		sidecar = nullptr;
+		return;
+	}
+	stats.sidecarIntervals = sidecar->getIntervalsNum();
+	Log::dbg("Feature sidecar %s: %zu features, %zu intervals", FeatureSidecar::pathFor(file).c_str(),
+		sidecar->getFeaturesNum(), sidecar->getIntervalsNum());
+}
+
+FeatureList *Project::generateFeatureList() const
+{
+	FeatureList *flist = cache ? cache->createFeatureList() : new FeatureList();
+	if (!cache)
+	{
+		for (FeatureTrack *track: tracks) { flist->push_back(track->createFeature()); }
+	}
+	if (sidecar) { sidecar->mergeInto(*flist); }
 	return flist;
 }
 
-Player *Project::createPlayer(demux_t *demux) const
+Feature *Project::createFeature(const FeatureTrack *track) const
+{
+	Feature *res = track->createFeature();
+	if (sidecar) { sidecar->mergeInto(*res); }
+	return res;
+}
+
+void Project::removeFeature(const std::string &name, ProjectUpdate &update) const
+{
+	//intervals of the sidecar stay, only the track is gone
+	Feature *rest = new Feature(name, "", "", "", 0);
+	if (sidecar) { sidecar->mergeInto(*rest); }
+	if (rest->getIntervals().empty())
+	{
+		delete rest;
+		update.removedFeatures.push_back(name);
+	}
+	else { update.features.push_back(rest); }
+}
+
+std::vector<MediaEntry> Project::getMediaEntries() const
 {
-	Player *player = new Player(demux, generateFeatureList(), fps);
+	std::vector<MediaEntry> res;
+	if (cache)
+	{
+		res.reserve(cache->getEntriesNum());
+		for (size_t id = 0; id < cache->getEntriesNum(); id++)
+		{
+			res.push_back(MediaEntry{cache->getEntryInterval(id), cache->getEntryResource(id)});
+		}
+		return res;
+	}
+	
+	res.reserve(mainPlaylist->getEntries().size());
 	for (const Entry &entry: mainPlaylist->getEntries())
 	{
-		player->addFile(entry.getInterval(), entry.getResource());
+		res.push_back(MediaEntry{entry.getInterval(), entry.getResource()});
 	}
-	return player;
+	return res;
+}
+
+int Project::nextNode(XmlReader *reader, Token &node)
+{
+	const char *name;
+	int type = reader->nextNode(&name);
+	node = (type == XmlReader::StartElem || type == XmlReader::EndElem) ? tokenize(name) : Token::Unknown;
+	return type;
 }
 
-int Project::nextSibling(xml_reader_t *reader, const std::string &curNode, bool curEmpty, std::string &resNode)
+bool Project::isOpen(XmlReader *reader, int type)
+{
+	return type == XmlReader::StartElem && !reader->isEmptyElement();
+}
+
+void Project::skipToEnd(XmlReader *reader, int depth)
 {
 	const char *node;
+	while (depth > 0)
+	{
+		int type = reader->nextNode(&node);
+		if (type <= XmlReader::None) { return; }
+		if (isOpen(reader, type)) { depth++; }
+		else if (type == XmlReader::EndElem) { depth--; }
+	}
+}
+
+int Project::nextSibling(XmlReader *reader, bool curOpen, Token &resNode)
+{
+	if (curOpen) { skipToEnd(reader, 1); }
+	return nextNode(reader, resNode);
+}
+
+Token Project::propertyName(XmlReader *reader)
+{
+	const char *value, *attr;
+	while ((attr = reader->nextAttr(&value)) != NULL)
+	{
+		if (tokenize(attr) == Token::Name) { return tokenize(value); }
+	}
+	return Token::Unknown;
+}
+
+bool Project::readText(XmlReader *reader, std::string_view &text)
+{
+	const char *value;
+	int type = reader->nextNode(&value);
+	if (type == XmlReader::Text)
+	{
+		text = value;
+		return false;
+	}
+	
+	text = std::string_view();
+	if (type == XmlReader::StartElem) { skipToEnd(reader, reader->isEmptyElement() ? 1 : 2); }
+	return true;
+}
+
+bool Project::indexSections()
+{
+	MappedFile mapped(sourceFile);
+	if (!mapped.isValid() || cache || mapped.getMtime() != loadMtime) { return false; }
+	return ProjectSection::scan((const char *)mapped.getData(), mapped.getSize(), sections);
+}
+
+void Project::swapModel(Project &other)
+{
+	std::swap(valid, other.valid);
+	std::swap(frameRate, other.frameRate);
+	playlists.swap(other.playlists);
+	producers.swap(other.producers);
+	tracks.swap(other.tracks);
+	producerIndex.swap(other.producerIndex);
+	playlistIndex.swap(other.playlistIndex);
+	std::swap(mainPlaylist, other.mainPlaylist);
+	std::swap(cache, other.cache);
+	std::swap(sidecar, other.sidecar);
+	std::swap(arena, other.arena);
+}
+
+//positions reader of section data at its top element
+static XmlReader *openSection(const char *data, const ProjectSection &section,
+	const std::function<XmlReader *(const char *, size_t)> &createReader, Token tag)
+{
+	XmlReader *reader = createReader(data + section.offset, section.size);
+	if (!reader) { return nullptr; }
+	
+	Token node;
 	int type;
-	if (!curEmpty)
+	do { type = Project::nextNode(reader, node); }
+	while (type > XmlReader::None && !(type == XmlReader::StartElem && node == tag));
+	
+	if (type <= XmlReader::None) 
+	{
+		delete reader;
+		return nullptr;
+	}
+	return reader;
+}
+
+bool Project::reloadSection(const char *data, const ProjectSection &section,
+	const std::function<XmlReader *(const char *, size_t)> &createReader, ProjectUpdate &update,
+	std::unordered_set<std::string> &changedPlaylists, std::unordered_set<std::string> &changedTracks)
+{
+	Token tag = tokenize(section.name);
+	if (tag != Token::Producer && tag != Token::Playlist && tag != Token::Tractor)
+	{
+		update.mediaChanged = true;
+		return true;
+	}
+	
+	XmlReader *reader = openSection(data, section, createReader, tag);
+	if (!reader) 
+	{
+		Log::err("Unable to parse %s %s", section.name.c_str(), section.id.c_str());
+		return false;
+	}
+	
+	if (tag == Token::Producer)
+	{
+		//producers of main playlist entries stay, new ones may be clips of new feature intervals
+		//replaced objects stay in arena until the next full parse
+		Producer *p = arena->create<Producer>(reader, *arena);
+		if (!*p->getName() || producerIndex.count(p->getName()))
+		{
+			update.mediaChanged = true;
+		}
+		else
+		{
+			producers.push_back(p);
+			producerIndex.emplace(p->getName(), p);
+		}
+	}
+	else if (tag == Token::Playlist)
+	{
+		Playlist *p = arena->create<Playlist>(reader, frameRate, *arena);
+		auto old = playlistIndex.find(section.id);
+		Playlist *oldPlaylist = (old != playlistIndex.end()) ? old->second : nullptr;
+		
+		if (oldPlaylist && oldPlaylist == mainPlaylist) { update.mediaChanged = true; }
+		else if (p->isEmpty()) { removeSection(section, update, changedPlaylists); }
+		else if (!p->bindProducers(producerIndex)) { delete reader; return false; }
+		else if (!p->isFeature()) { update.mediaChanged = true; }
+		else
+		{
+			if (oldPlaylist) { std::replace(playlists.begin(), playlists.end(), oldPlaylist, p); }
+			else { playlists.push_back(p); }
+			playlistIndex[p->getName()] = p;
+			changedPlaylists.insert(p->getName());
+		}
+	}
+	else
+	{
+		FeatureTrack *t = arena->create<FeatureTrack>(reader, *arena);
+		auto old = std::find_if(tracks.begin(), tracks.end(), 
+			[&section](FeatureTrack *track) { return track->getName() == section.id; });
+		
+		if (old != tracks.end())
+		{
+			if (!t->isValid() || strcmp(t->getFeatureName(), (*old)->getFeatureName()) != 0)
+			{
+				removeFeature((*old)->getFeatureName(), update);
+			}
+			tracks.erase(old);
+		}
+		
+		if (t->isValid())
+		{
+			tracks.push_back(t);
+			changedTracks.insert(t->getName());
+		}
+	}
+	
+	delete reader;
+	return true;
+}
+
+void Project::removeSection(const ProjectSection &section, ProjectUpdate &update,
+	std::unordered_set<std::string> &changedPlaylists)
+{
+	Token tag = tokenize(section.name);
+	if (tag == Token::Playlist)
+	{
+		auto it = playlistIndex.find(section.id);
+		if (it == playlistIndex.end()) { return; }
+		if (it->second == mainPlaylist) { update.mediaChanged = true; return; }
+		
+		playlists.erase(std::remove(playlists.begin(), playlists.end(), it->second), playlists.end());
+		playlistIndex.erase(it);
+		changedPlaylists.insert(section.id);
+	}
+	else if (tag == Token::Tractor)
 	{
-		do
+		auto it = std::find_if(tracks.begin(), tracks.end(), 
+			[&section](FeatureTrack *track) { return track->getName() == section.id; });
+		if (it == tracks.end()) { return; }
+		
+		removeFeature((*it)->getFeatureName(), update);
+		tracks.erase(it);
+	}
+	else if (tag != Token::Producer) { update.mediaChanged = true; }
+}
+
+bool Project::reload(const std::function<XmlReader *(const char *, size_t)> &createReader, ProjectUpdate &update)
+{
+	MappedFile mapped(sourceFile);
+	std::vector<ProjectSection> newSections;
+	const char *data = (const char *)mapped.getData();
+	if (!mapped.isValid() || !ProjectSection::scan(data, mapped.getSize(), newSections))
+	{
+		Log::err("Unable to read changed project %s", sourceFile.c_str());
+		return false;
+	}
+	
+	if (sections.empty())
+	{
+		//nothing to compare with (loaded from cache or file changed before indexing), parse it all
+		Project fresh(sourceFile, [&]() { return createReader(data, mapped.getSize()); }, false);
+		if (!fresh.isValid()) { return false; }
+		
+		std::vector<MediaEntry> oldEntries = getMediaEntries(), newEntries = fresh.getMediaEntries();
+		update.mediaChanged = !std::equal(oldEntries.begin(), oldEntries.end(), newEntries.begin(), newEntries.end(),
+			[](const MediaEntry &a, const MediaEntry &b) { return a.interval.in == b.interval.in && 
+				a.interval.out == b.interval.out && a.resource == b.resource; });
+		
+		FeatureList *oldFeatures = generateFeatureList();
+		FeatureList *freshFeatures = fresh.generateFeatureList();
+		update.features.swap(*freshFeatures);
+		delete freshFeatures;
+		for (Feature *f: *oldFeatures)
 		{
-			type = xml_ReaderNextNode(reader, &node);
+			if (!update.features.find(f->getName())) { update.removedFeatures.push_back(f->getName()); }
 		}
-		while (!(type == XML_READER_ENDELEM && std::string(node) == curNode));
+		delete oldFeatures;
+		
+		fresh.storeCache(sourceFile);
+		swapModel(fresh);
+		sections.swap(newSections);
+		return true;
 	}
 	
-	type = xml_ReaderNextNode(reader, &node);
-	resNode = std::string(node);
-	return type;
+	std::unordered_map<std::string, const ProjectSection *> oldSections;
+	for (const ProjectSection &section: sections) { oldSections.emplace(section.getKey(), &section); }
+	
+	//producers first, new feature intervals may refer to new clips
+	std::vector<const ProjectSection *> changed;
+	for (const ProjectSection &section: newSections)
+	{
+		auto old = oldSections.find(section.getKey());
+		if (old == oldSections.end() || old->second->hash != section.hash) { changed.push_back(&section); }
+		if (old != oldSections.end()) { oldSections.erase(old); }
+	}
+	std::stable_partition(changed.begin(), changed.end(), 
+		[](const ProjectSection *section) { return tokenize(section->name) == Token::Producer; });
+	
+	std::unordered_set<std::string> changedPlaylists, changedTracks;
+	for (const ProjectSection *section: changed)
+	{
+		Log::dbg("Project section changed: %s %s", section->name.c_str(), section->id.c_str());
+		if (!reloadSection(data, *section, createReader, update, changedPlaylists, changedTracks))
+		{
+			sections.clear(); //model may be partially updated, next reload parses everything
+			return false;
+		}
+	}
+	for (const auto &removed: oldSections)
+	{
+		Log::dbg("Project section removed: %s %s", removed.second->name.c_str(), removed.second->id.c_str());
+		removeSection(*removed.second, update, changedPlaylists);
+	}
+	
+	for (FeatureTrack *track: tracks)
+	{
+		bool affected = changedTracks.count(track->getName());
+		track->setPlaylist(nullptr);
+		for (const char *playlistName: track->getPlaylists())
+		{
+			auto it = playlistIndex.find(playlistName);
+			if (it != playlistIndex.end()) { track->setPlaylist(it->second); }
+			if (changedPlaylists.count(playlistName)) { affected = true; }
+		}
+		if (affected) { update.features.push_back(createFeature(track)); }
+	}
+	
+	sections.swap(newSections);
+	return true;
 }
 
 bool Project::bindProducers()
 {
 	for (Playlist *p: playlists)
 	{
-		p->bindProducers(producers);
+		if (!p->bindProducers(producerIndex)) { return false; }
 		if (!p->isFeature()) 
 		{ 
 			if (mainPlaylist != nullptr)
 			{
-				msg_Err(obj, "Multiple main playlists");
+				Log::err("Multiple main playlists");
 				return false;
 			}
 			mainPlaylist = p; 
@@ -567,7 +925,7 @@ bool Project::bindProducers()
 	
 	if (mainPlaylist == nullptr)
 	{
-		msg_Err(obj, "Main playlist not found");
+		Log::err("Main playlist not found");
 		return false;
 	}
 	
@@ -579,32 +937,50 @@ bool Project::bindTracks()
 	for (FeatureTrack *track: tracks)
 	{
 		bool found = false;
-		for (const std::string &playlistName: track->getPlaylists())
+		for (const char *playlistName: track->getPlaylists())
 		{
-			for (Playlist *playlist: playlists)
+			auto it = playlistIndex.find(playlistName);
+			if (it != playlistIndex.end())
 			{
-				if (playlist->getName() == playlistName)
-				{
-					track->setPlaylist(playlist);
-					found = true;
-					break;
-				}
+				track->setPlaylist(it->second);
+				found = true;
 			}
 		}
 		if (!found)
 		{
-			msg_Err(obj, "No playlist for feature track");
+			Log::err("No playlist for feature track");
 			return false;
 		}
 	}
 	return true;
 }
 
-bool Entry::updatePath(const std::string &parentPath) 
-{ 
-	return producerPtr->updatePath(parentPath);
+bool Project::updatePaths(const std::string &parentPath)
+{
+	//every producer is resolved once, however many entries refer to it
+	std::vector<Producer *> used;
+	std::unordered_set<Producer *> seen;
+	for (const Entry &e: mainPlaylist->getEntries())
+	{
+		if (seen.insert(e.getProducer()).second) { used.push_back(e.getProducer()); }
+	}
+	
+	PathResolver resolver(parentPath);
+	for (Producer *p: used)
+	{
+		resolver.addResource(p->getResource());
+	}
+	resolver.index();
+	
+	bool res = true;
+	for (Producer *p: used)
+	{
+		res &= p->updatePath(resolver, *arena);
+	}
+	stats.directories = resolver.getDirectoriesNum();
+	stats.pathLookups = resolver.getLookupsNum();
+	return res;
 }
 
 
-
 }
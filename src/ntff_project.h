@@ -2,42 +2,91 @@
 #define NTFF_PROJECT_H
 
 #include <string>
-#include <list>
-struct stream_t;
-struct vlc_object_t;
-struct xml_reader_t;
-struct demux_t;
+#include <string_view>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include "ntff_feature.h"
+#include "ntff_timecode.h"
+#include "ntff_sections.h"
+#include "ntff_stats.h"
 
 namespace Ntff {
 
 class Playlist;
 class Producer;
-class FeatureList;
 class FeatureTrack;
-class Player;
+class ProjectCache;
+class Arena;
+class FeatureSidecar;
+class XmlReader;
+enum class Token : uint8_t;
+
+struct MediaEntry
+{
+	Interval interval;
+	std::string resource;
+};
+
+struct ProjectUpdate
+{
+	ProjectUpdate(): mediaChanged(false) {}
+	FeatureList features; //feature tracks changed or added, with their new intervals
+	std::vector<std::string> removedFeatures;
+	bool mediaChanged; //main playlist or its producers changed, not applied while playing
+};
 
 class Project
 {
 	public:
-		Project(vlc_object_t *obj, const char *file, stream_t *stream);
+		Project(const std::string &file, const std::function<XmlReader *()> &createReader,
+			bool useCache = true);
+		~Project();
 		bool isValid() const { return valid; }
-		Player *createPlayer(demux_t *demux) const;
-		
-		static int nextSibling(xml_reader_t *reader, const std::string &curNode, 
-			bool curEmpty, std::string &resNode);
-		static vlc_object_t *getVlcObj() { return obj; }
+		const FrameRate &getFrameRate() const { return frameRate; }
+		const LoadStats &getStats() const { return stats; }
+		std::vector<MediaEntry> getMediaEntries() const;
+		FeatureList *generateFeatureList() const;
+		bool indexSections();
+		bool reload(const std::function<XmlReader *(const char *, size_t)> &createReader, ProjectUpdate &update);
+
+		static int nextNode(XmlReader *reader, Token &node);
+		static int nextSibling(XmlReader *reader, bool curOpen, Token &resNode);
+		static bool isOpen(XmlReader *reader, int type);
+		static void skipToEnd(XmlReader *reader, int depth);
+		static Token propertyName(XmlReader *reader);
+		static bool readText(XmlReader *reader, std::string_view &text); //view into reader, until next node
 	private:
-		static vlc_object_t *obj;
 		bool valid;
-		double fps;
-		std::list<Playlist *>playlists;
-		std::list<Producer *>producers;
-		std::list<FeatureTrack *>tracks;
+		std::string sourceFile;
+		int64_t loadMtime;
+		std::vector<ProjectSection> sections;
+		FrameRate frameRate;
+		Arena *arena; //owns the model below, keys of indexes are interned there
+		std::vector<Playlist *> playlists;
+		std::vector<Producer *> producers;
+		std::vector<FeatureTrack *> tracks;
+		std::unordered_map<std::string_view, Producer *> producerIndex;
+		std::unordered_map<std::string_view, Playlist *> playlistIndex;
 		Playlist *mainPlaylist;
-		
+		ProjectCache *cache;
+		FeatureSidecar *sidecar; //features of detectors, merged into the ones of tracks
+		LoadStats stats;
+
 		bool bindProducers();
 		bool bindTracks();
-		FeatureList *generateFeatureList() const;
+		bool updatePaths(const std::string &parentPath);
+		void storeCache(const std::string &file) const;
+		void loadSidecar(const std::string &file);
+		Feature *createFeature(const FeatureTrack *track) const;
+		void removeFeature(const std::string &name, ProjectUpdate &update) const;
+		void swapModel(Project &other);
+		bool reloadSection(const char *data, const ProjectSection &section,
+			const std::function<XmlReader *(const char *, size_t)> &createReader, ProjectUpdate &update,
+			std::unordered_set<std::string> &changedPlaylists, std::unordered_set<std::string> &changedTracks);
+		void removeSection(const ProjectSection &section, ProjectUpdate &update,
+			std::unordered_set<std::string> &changedPlaylists);
 };
 
 
@@ -0,0 +1,96 @@
+#include "ntff_resolver.h"
+#include <filesystem>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+namespace Ntff {
+
+static const unsigned maxListingThreads = 16;
+
+std::vector<PathResolver::Candidate> PathResolver::getCandidates(const std::string &resource) const
+{
+	std::filesystem::path resourcePath(resource);
+	std::string filename = resourcePath.filename();
+
+	std::filesystem::path resDirectory;
+	for (const std::filesystem::path &e: resourcePath.parent_path())
+	{
+		resDirectory = e;
+	}
+
+	std::vector<Candidate> res;
+	res.push_back(Candidate{parentPath, filename});
+	if (!resDirectory.empty())
+	{
+		res.push_back(Candidate{std::filesystem::path(parentPath)/resDirectory, filename});
+	}
+	return res;
+}
+
+void PathResolver::addResource(const std::string &resource)
+{
+	for (const Candidate &candidate: getCandidates(resource))
+	{
+		directories[candidate.directory];
+	}
+}
+
+void PathResolver::listDirectory(const std::string &directory, std::unordered_set<std::string> &files)
+{
+	//project opened by bare file name, resolved paths stay relative to the working directory
+	std::error_code ec;
+	std::filesystem::directory_iterator it(directory.empty() ? "." : directory, ec);
+	for (; !ec && it != std::filesystem::directory_iterator(); it.increment(ec))
+	{
+		std::error_code typeEc;
+		if (it->is_directory(typeEc)) { continue; }
+		files.insert(it->path().filename());
+	}
+}
+
+void PathResolver::index()
+{
+	std::vector<std::pair<const std::string, std::unordered_set<std::string>> *> pending;
+	for (auto &dir: directories)
+	{
+		dir.second.clear();
+		pending.push_back(&dir);
+	}
+
+	//directories are independent, so slow (network) filesystems are listed concurrently
+	std::atomic<size_t> next(0);
+	auto worker = [&pending, &next]()
+	{
+		for (size_t id = next++; id < pending.size(); id = next++)
+		{
+			listDirectory(pending[id]->first, pending[id]->second);
+		}
+	};
+
+	unsigned threadsNum = std::min<size_t>(pending.size(), maxListingThreads);
+	std::vector<std::thread> threads;
+	for (unsigned i = 1; i < threadsNum; i++)
+	{
+		threads.emplace_back(worker);
+	}
+	worker();
+	for (std::thread &t: threads) { t.join(); }
+}
+
+bool PathResolver::resolve(const std::string &resource, std::string &resolved) const
+{
+	for (const Candidate &candidate: getCandidates(resource))
+	{
+		lookupsNum++;
+		auto dir = directories.find(candidate.directory);
+		if (dir != directories.end() && dir->second.count(candidate.filename))
+		{
+			resolved = std::filesystem::path(candidate.directory)/candidate.filename;
+			return true;
+		}
+	}
+	return false;
+}
+
+}
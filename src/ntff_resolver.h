@@ -0,0 +1,40 @@
+#ifndef NTFF_RESOLVER_H
+#define NTFF_RESOLVER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_set>
+
+namespace Ntff {
+
+/* Resolves media paths stored in the project relative to the project directory.
+ * Every resource is looked up as <parent>/<file> and <parent>/<last dir>/<file>.
+ * Candidate directories are listed once (in parallel) instead of probing files. */
+class PathResolver
+{
+public:
+	PathResolver(const std::string &parentPath): parentPath(parentPath), lookupsNum(0) {}
+	void addResource(const std::string &resource);
+	void index();
+	bool resolve(const std::string &resource, std::string &resolved) const;
+	size_t getDirectoriesNum() const { return directories.size(); }
+	size_t getLookupsNum() const { return lookupsNum; }
+private:
+	struct Candidate
+	{
+		std::string directory;
+		std::string filename;
+	};
+
+	std::string parentPath;
+	std::map<std::string, std::unordered_set<std::string>> directories;
+	mutable size_t lookupsNum; //statistics only
+
+	std::vector<Candidate> getCandidates(const std::string &resource) const;
+	static void listDirectory(const std::string &directory, std::unordered_set<std::string> &files);
+};
+
+}
+
+#endif // NTFF_RESOLVER_H
@@ -0,0 +1,113 @@
+#include "ntff_sections.h"
+#include "ntff_mmap.h"
+#include <cstring>
+
+namespace Ntff {
+
+static const char *skipPast(const char *pos, const char *end, const char *token)
+{
+	size_t len = strlen(token);
+	for (; pos + len <= end; pos++)
+	{
+		pos = (const char *)memchr(pos, token[0], end - pos);
+		if (!pos || pos + len > end) { return nullptr; }
+		if (memcmp(pos, token, len) == 0) { return pos + len; }
+	}
+	return nullptr;
+}
+
+static bool startsWith(const char *pos, const char *end, const char *token)
+{
+	size_t len = strlen(token);
+	return (size_t)(end - pos) >= len && memcmp(pos, token, len) == 0;
+}
+
+static bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+
+//parses start tag after '<', returns position after '>', nullptr for malformed tag
+static const char *scanStartTag(const char *pos, const char *end, std::string &name, std::string &id, bool &empty)
+{
+	const char *nameBegin = pos;
+	while (pos < end && !isSpace(*pos) && *pos != '/' && *pos != '>') { pos++; }
+	name.assign(nameBegin, pos);
+	id.clear();
+
+	while (pos < end)
+	{
+		if (*pos == '>') { empty = (pos[-1] == '/'); return pos + 1; }
+		if (isSpace(*pos) || *pos == '/') { pos++; continue; }
+
+		const char *attrBegin = pos;
+		while (pos < end && *pos != '=' && *pos != '>' && !isSpace(*pos)) { pos++; }
+		size_t attrLen = pos - attrBegin;
+		while (pos < end && isSpace(*pos)) { pos++; }
+		if (pos >= end || *pos != '=') { continue; }
+		pos++;
+		while (pos < end && isSpace(*pos)) { pos++; }
+		if (pos >= end || (*pos != '"' && *pos != '\'')) { return nullptr; }
+
+		const char *valueEnd = (const char *)memchr(pos + 1, *pos, end - pos - 1);
+		if (!valueEnd) { return nullptr; }
+		if (attrLen == 2 && memcmp(attrBegin, "id", 2) == 0) { id.assign(pos + 1, valueEnd); }
+		pos = valueEnd + 1;
+	}
+	return nullptr;
+}
+
+bool ProjectSection::scan(const char *data, size_t size, std::vector<ProjectSection> &sections)
+{
+	sections.clear();
+	const char *pos = data;
+	const char *end = data + size;
+	int depth = 0;
+	ProjectSection section;
+
+	while ((pos = (const char *)memchr(pos, '<', end - pos)) != nullptr)
+	{
+		const char *tagBegin = pos;
+		pos++;
+		if (startsWith(pos, end, "!--")) { pos = skipPast(pos, end, "-->"); }
+		else if (startsWith(pos, end, "![CDATA[")) { pos = skipPast(pos, end, "]]>"); }
+		else if (startsWith(pos, end, "?")) { pos = skipPast(pos, end, "?>"); }
+		else if (startsWith(pos, end, "!")) { pos = skipPast(pos, end, ">"); }
+		else if (startsWith(pos, end, "/"))
+		{
+			pos = skipPast(pos, end, ">");
+			if (!pos) { return false; }
+			if (--depth == 1)
+			{
+				section.size = pos - data - section.offset;
+				sections.push_back(section);
+			}
+		}
+		else
+		{
+			std::string name, id;
+			bool empty = false;
+			pos = scanStartTag(pos, end, name, id, empty);
+			if (!pos) { return false; }
+			if (depth == 1)
+			{
+				section.name = name;
+				section.id = id;
+				section.offset = tagBegin - data;
+				if (empty)
+				{
+					section.size = pos - tagBegin;
+					sections.push_back(section);
+				}
+			}
+			if (!empty) { depth++; }
+		}
+		if (!pos) { return false; }
+	}
+	if (depth != 0) { return false; }
+
+	for (ProjectSection &s: sections)
+	{
+		s.hash = MappedFile::hash((const uint8_t *)data + s.offset, s.size);
+	}
+	return true;
+}
+
+}
@@ -0,0 +1,29 @@
+#ifndef NTFF_SECTIONS_H
+#define NTFF_SECTIONS_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace Ntff {
+
+/* Top level element of the project (child of <mlt>): producer, playlist, tractor...
+ * Located by light scan of raw XML, so changed sections are found by hash
+ * and only they are parsed again on reload. */
+struct ProjectSection
+{
+	std::string name;
+	std::string id;
+	size_t offset;
+	size_t size;
+	uint64_t hash;
+
+	std::string getKey() const { return name + ":" + id; }
+
+	static bool scan(const char *data, size_t size, std::vector<ProjectSection> &sections);
+};
+
+}
+
+#endif // NTFF_SECTIONS_H
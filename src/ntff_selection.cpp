@@ -0,0 +1,282 @@
+#include "ntff_selection.h"
+#include "ntff_bitmap.h"
+#include <limits>
+#include <algorithm>
+#include <sstream>
+#include <cstdlib>
+
+namespace Ntff {
+
+static const frame_id denseIntervalLength = 16;
+
+bool SelectionRule::getIntensityRange(int8_t &min, int8_t &max) const
+{
+	return getIntensityRange(eq, intensity, min, max);
+}
+
+bool SelectionRule::getIntensityRange(Comparison eq, int8_t intensity, int8_t &min, int8_t &max)
+{
+	//the same empty range for both, so cache keys of such rules match
+	if ((eq == Less && intensity == std::numeric_limits<int8_t>::min()) ||
+		(eq == More && intensity == std::numeric_limits<int8_t>::max()))
+	{
+		min = std::numeric_limits<int8_t>::max();
+		max = std::numeric_limits<int8_t>::min();
+		return false;
+	}
+	if (eq == Less || eq == LessOrEq)
+	{
+		min = std::numeric_limits<int8_t>::min();
+		max = intensity;
+		if (eq == Less) { max--; }
+	}
+	else
+	{
+		max = std::numeric_limits<int8_t>::max();
+		min = intensity;
+		if (eq == More) { min++; }
+	}
+	return true;
+}
+
+bool SelectionRule::parseComparison(const std::string &str, Comparison &eq)
+{
+	if (str == "<") { eq = Less; }
+	else if (str == ">") { eq = More; }
+	else if (str == "<=" || str == "≤") { eq = LessOrEq; }
+	else if (str == ">=" || str == "≥") { eq = MoreOrEq; }
+	else { return false; }
+	return true;
+}
+
+const char *SelectionRule::comparisonStr(Comparison eq)
+{
+	switch (eq)
+	{
+		case Less: return "<";
+		case More: return ">";
+		case LessOrEq: return "≤";
+		default: return "≥";
+	}
+}
+
+void Selection::apply(IntervalSet &container, frame_id wholeDuration, Engine engine) const
+{
+	if (engine == Bitmap || (engine == Auto && isDense()))
+	{
+		applyBitmap(container, wholeDuration);
+		return;
+	}
+	container.clear();
+	if (beginAdd)
+	{
+		container.insert(Interval(0, wholeDuration));
+	}
+	
+	for (const SelectionRule &rule: rules)
+	{
+		int8_t min, max;
+		if (!rule.getIntensityRange(min, max) && !rule.affectUnmarked) { continue; } //changes no frames
+		FeatureList::modifyIntervals(container, rule.add, rule.feature, min, max, 
+			rule.affectUnmarked, wholeDuration);
+	}
+}
+
+//intervals are a few frames long on average, as ML detectors mark them
+bool Selection::isDense() const
+{
+	size_t intervalsNum = 0;
+	frame_id length = 0;
+	for (const SelectionRule &rule: rules)
+	{
+		length += rule.feature->getIntervalsLength();
+		intervalsNum += rule.feature->getIntervals().size();
+	}
+	return intervalsNum > 0 && length / (frame_id)intervalsNum < denseIntervalLength;
+}
+
+void Selection::applyBitmap(IntervalSet &container, frame_id wholeDuration) const
+{
+	FrameBitmap res;
+	if (beginAdd) { res = FrameBitmap::fromSet(IntervalSet(Interval(0, wholeDuration))); }
+	for (const SelectionRule &rule: rules)
+	{
+		if (!rule.add && res.empty()) { continue; }
+		int8_t min, max;
+		if (!rule.getIntensityRange(min, max) && !rule.affectUnmarked) { continue; }
+		FrameBitmap affected = FrameBitmap::fromSet(rule.feature->getIntervalsUnion(min, max));
+		if (rule.affectUnmarked) { affected.unite(FrameBitmap::fromSet(rule.feature->getUnmarked(wholeDuration))); }
+		if (rule.add) { res.unite(affected); }
+		else { res.subtract(affected); }
+	}
+	container = res.toSet();
+}
+
+SelectionCache::Key SelectionCache::makeKey(const SelectionRule &rule)
+{
+	Key res{rule.feature, rule.feature->getRevision(), 0, 0, rule.affectUnmarked};
+	rule.getIntensityRange(res.min, res.max);
+	return res;
+}
+
+void SelectionCache::apply(const Selection &selection, IntervalSet &container, frame_id duration)
+{
+	if (duration != wholeDuration) { clear(); }
+	if (selection.getBeginAction() != beginAdd) { stages.clear(); }
+	wholeDuration = duration;
+	beginAdd = selection.getBeginAction();
+
+	const std::vector<SelectionRule> &rules = selection.getRules();
+	size_t same = 0;
+	for (; same < std::min(stages.size(), rules.size()); same++)
+	{
+		const SelectionRule &rule = rules[same];
+		if (!(stages[same].key == makeKey(rule)) || stages[same].add != rule.add) { break; }
+	}
+	stages.resize(same);
+	reusedNum = same;
+
+	IntervalSet cur;
+	if (!stages.empty()) { cur = stages.back().result; }
+	else if (beginAdd) { cur.insert(Interval(0, wholeDuration)); }
+	for (size_t i = same; i < rules.size(); i++)
+	{
+		const SelectionRule &rule = rules[i];
+		Key key = makeKey(rule);
+		FeatureList::modifyIntervals(cur, rule.add, rule.feature, key.min, key.max, rule.affectUnmarked,
+			wholeDuration);
+		stages.push_back(Stage{key, rule.add, cur});
+	}
+	container = cur;
+}
+
+//from the last rule back, rules after the current one are summed up as frames they keep
+//from before (kept) and frames they add (added, not removed later)
+void SelectionLengths::update(const Selection &selection, const SelectionCache &cache, frame_id wholeDuration)
+{
+	const std::vector<SelectionRule> &selectionRules = selection.getRules();
+	rules.resize(selectionRules.size());
+	IntervalSet begin;
+	if (selection.getBeginAction()) { begin.insert(Interval(0, wholeDuration)); }
+	//rows after the current one select (A ∩ kept) ∪ added from A, open is kept \ added
+	IntervalSet open(Interval(0, std::numeric_limits<frame_id>::max())), added;
+	for (size_t i = selectionRules.size(); i-- > 0;)
+	{
+		const SelectionRule &rule = selectionRules[i];
+		const IntervalSet &before = i ? cache.getResult(i - 1) : begin;
+		RuleLengths &res = rules[i];
+		res.add = rule.add;
+		res.base = added.length() + before.intersectionLength(open);
+		IntervalSet changed = open; //the rule decides on frames kept and not added later
+		if (rule.add) { changed.subtract(before); }
+		else { changed.intersect(before); }
+		rule.feature->getIntensityLengths(changed, res.byHighest, res.byLowest);
+		const IntervalSet &unmarked = rule.feature->getUnmarked(wholeDuration);
+		res.unmarked = rule.affectUnmarked ? unmarked.intersectionLength(changed) : 0;
+
+		//the rule goes before the ones summed up: frames it adds stay if they are open
+		int8_t min, max;
+		rule.getIntensityRange(min, max);
+		const IntervalSet *affected = &rule.feature->getIntervalsUnion(min, max);
+		IntervalSet withUnmarked;
+		if (rule.affectUnmarked)
+		{
+			withUnmarked = *affected;
+			withUnmarked.unite(unmarked);
+			affected = &withUnmarked;
+		}
+		if (rule.add)
+		{
+			IntervalSet stays = open;
+			stays.intersect(*affected);
+			added.unite(stays);
+		}
+		open.subtract(*affected);
+	}
+}
+
+//frames marked below a value are the ones with the lowest intensity below it, above - with the highest
+frame_id SelectionLengths::get(size_t rule, Comparison eq, int8_t intensity) const
+{
+	const RuleLengths &lengths = rules[rule];
+	int8_t min, max;
+	frame_id changed = lengths.unmarked;
+	if (!SelectionRule::getIntensityRange(eq, intensity, min, max)) {} //no marked frames
+	else if (eq == Less || eq == LessOrEq)
+	{
+		for (const auto &p: lengths.byLowest) { if (p.first <= max) { changed += p.second; } }
+	}
+	else
+	{
+		for (const auto &p: lengths.byHighest) { if (p.first >= min) { changed += p.second; } }
+	}
+	return lengths.add ? lengths.base + changed : lengths.base - changed;
+}
+
+bool Selection::parseAction(const std::string &str, bool &add)
+{
+	if (str == "add") { add = true; }
+	else if (str == "remove") { add = false; }
+	else { return false; }
+	return true;
+}
+
+bool Selection::parseRule(const std::string &text, const FeatureList &features, 
+	SelectionRule &rule, std::string &error)
+{
+	std::vector<std::string> fields;
+	std::stringstream ss(text);
+	std::string field;
+	while (std::getline(ss, field, ',')) { fields.push_back(field); }
+	
+	if (fields.size() != 4 && fields.size() != 5)
+	{
+		error = "expected <feature>,<add|remove>,<comparison>,<intensity>[,unmarked]";
+		return false;
+	}
+	
+	rule.feature = features.find(fields[0]);
+	if (!rule.feature) { error = "unknown feature \"" + fields[0] + "\""; return false; }
+	if (!parseAction(fields[1], rule.add)) { error = "unknown action \"" + fields[1] + "\""; return false; }
+	if (!SelectionRule::parseComparison(fields[2], rule.eq)) 
+	{
+		error = "unknown comparison \"" + fields[2] + "\""; 
+		return false;
+	}
+	
+	char *end;
+	long intensity = strtol(fields[3].c_str(), &end, 10);
+	if (fields[3].empty() || *end != '\0' || 
+		intensity < std::numeric_limits<int8_t>::min() || intensity > std::numeric_limits<int8_t>::max())
+	{
+		error = "invalid intensity \"" + fields[3] + "\"";
+		return false;
+	}
+	rule.intensity = intensity;
+	
+	rule.affectUnmarked = false;
+	if (fields.size() == 5)
+	{
+		if (fields[4] != "unmarked") { error = "unknown flag \"" + fields[4] + "\""; return false; }
+		rule.affectUnmarked = true;
+	}
+	return true;
+}
+
+Selection Selection::recommended(const FeatureList &features)
+{
+	Selection res;
+	for (const Feature *feature: features)
+	{
+		SelectionRule rule;
+		rule.feature = feature;
+		rule.add = feature->getAction() == "add";
+		if (!SelectionRule::parseComparison(feature->getEq(), rule.eq)) { rule.eq = Less; }
+		rule.intensity = feature->getRecIntensity();
+		rule.affectUnmarked = false;
+		res.append(rule);
+	}
+	return res;
+}
+
+}
@@ -0,0 +1,123 @@
+#ifndef NTFF_SELECTION_H
+#define NTFF_SELECTION_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include "ntff_feature.h"
+#include "ntff_intervals.h"
+
+namespace Ntff {
+
+enum Comparison {Less, More, LessOrEq, MoreOrEq};
+
+struct SelectionRule
+{
+	const Feature *feature;
+	bool add;
+	Comparison eq;
+	int8_t intensity;
+	bool affectUnmarked;
+
+	//false when no intensity compares true (below the lowest, above the highest), min > max then
+	bool getIntensityRange(int8_t &min, int8_t &max) const;
+	static bool getIntensityRange(Comparison eq, int8_t intensity, int8_t &min, int8_t &max);
+	static bool parseComparison(const std::string &str, Comparison &eq);
+	static const char *comparisonStr(Comparison eq);
+};
+
+/* Ordered list of add/remove rules applied on top of "add" or "remove" everything,
+ * the same thing Dialog lets user build row by row. */
+class Selection
+{
+public:
+	Selection(): beginAdd(false) {}
+	void setBeginAction(bool add) { beginAdd = add; }
+	bool getBeginAction() const { return beginAdd; }
+	void append(const SelectionRule &rule) { rules.push_back(rule); }
+	const std::vector<SelectionRule> &getRules() const { return rules; }
+	enum Engine {Auto, Intervals, Bitmap};
+	//Auto takes Bitmap when features of the rules are dense, see isDense()
+	void apply(IntervalSet &container, frame_id wholeDuration, Engine engine = Auto) const;
+	bool isDense() const;
+
+	//rule format: <feature name>,<add|remove>,<comparison>,<intensity>[,unmarked]
+	static bool parseRule(const std::string &text, const FeatureList &features,
+		SelectionRule &rule, std::string &error);
+	static bool parseAction(const std::string &str, bool &add);
+	static Selection recommended(const FeatureList &features);
+private:
+	bool beginAdd;
+	std::vector<SelectionRule> rules;
+
+	void applyBitmap(IntervalSet &container, frame_id wholeDuration) const;
+};
+
+/* Applies selections that differ from the previous one in a few rows, as the
+ * dialog does while user drags a value. Intervals after every rule are kept, so
+ * only rules from the first changed one are applied again, on unions (and the
+ * unmarked frames) features keep themselves. */
+class SelectionCache
+{
+public:
+	SelectionCache(): wholeDuration(0), beginAdd(false), reusedNum(0) {}
+	void apply(const Selection &selection, IntervalSet &container, frame_id wholeDuration);
+	size_t getReusedNum() const { return reusedNum; } //rules not applied again by last apply()
+	const IntervalSet &getResult(size_t rule) const { return stages[rule].result; } //after the rule
+	void clear() { stages.clear(); }
+private:
+	struct Key
+	{
+		const Feature *feature;
+		unsigned revision;
+		int8_t min;
+		int8_t max;
+		bool unmarked;
+
+		bool operator==(const Key &other) const
+		{
+			return feature == other.feature && revision == other.revision && min == other.min &&
+				max == other.max && unmarked == other.unmarked;
+		}
+	};
+	struct Stage
+	{
+		Key key;
+		bool add;
+		IntervalSet result; //after the rule
+	};
+
+	frame_id wholeDuration;
+	bool beginAdd;
+	std::vector<Stage> stages;
+	size_t reusedNum;
+
+	static Key makeKey(const SelectionRule &rule);
+};
+
+/* Play length for every comparison and intensity of every rule, the others kept as
+ * they are. Rules after a rule keep some of frames before them and add some whatever
+ * comes before, so its value only changes frames of one set: lengths of the set by
+ * intensity of the feature are found once per update, a value is a sum of them. */
+class SelectionLengths
+{
+public:
+	//after cache applied the same selection
+	void update(const Selection &selection, const SelectionCache &cache, frame_id wholeDuration);
+	size_t size() const { return rules.size(); }
+	frame_id get(size_t rule, Comparison eq, int8_t intensity) const; //unmarked frames as the rule has it
+private:
+	struct RuleLengths
+	{
+		bool add;
+		frame_id base; //without the rule
+		frame_id unmarked; //of changed frames, when the rule affects them
+		std::map<int8_t, frame_id> byHighest; //changed frames by intensity
+		std::map<int8_t, frame_id> byLowest;
+	};
+	std::vector<RuleLengths> rules;
+};
+
+}
+
+#endif // NTFF_SELECTION_H
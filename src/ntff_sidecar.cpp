@@ -0,0 +1,210 @@
+#include "ntff_sidecar.h"
+#include "ntff_mmap.h"
+#include "ntff_log.h"
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <filesystem>
+
+namespace Ntff {
+
+static const char sidecarMagic[4] = {'N', 'T', 'F', 'S'};
+static const uint32_t sidecarVersion = 1;
+
+FeatureSidecar::FeatureSidecar(const std::string &projectFile, const FrameRate &frameRate):
+	file(nullptr), valid(false), header(nullptr), features(nullptr),
+	in(nullptr), out(nullptr), intensity(nullptr), strings(nullptr)
+{
+	std::string path = pathFor(projectFile);
+	std::error_code ec;
+	if (!std::filesystem::exists(path, ec)) { return; }
+
+	file = new MappedFile(path);
+	valid = file->isValid() && validate(frameRate);
+	if (!valid) { Log::err("Invalid feature sidecar %s, ignored", path.c_str()); }
+}
+
+FeatureSidecar::~FeatureSidecar()
+{
+	delete file;
+}
+
+std::string FeatureSidecar::pathFor(const std::string &projectFile)
+{
+	return std::filesystem::path(projectFile).replace_extension(".ntff");
+}
+
+bool FeatureSidecar::validate(const FrameRate &frameRate)
+{
+	const uint8_t *data = file->getData();
+	size_t size = file->getSize();
+	if (size < sizeof(Header)) { return false; }
+
+	header = (const Header *)data;
+	if (memcmp(header->magic, sidecarMagic, sizeof(sidecarMagic)) != 0) { return false; }
+	if (header->version != sidecarVersion) { return false; }
+	if (header->frameRateNum != frameRate.num || header->frameRateDen != frameRate.den)
+	{
+		Log::err("Feature sidecar frame rate %d/%d differs from project %d/%d",
+			header->frameRateNum, header->frameRateDen, frameRate.num, frameRate.den);
+		return false;
+	}
+
+	const uint64_t intervalSize = 2 * sizeof(int64_t) + sizeof(int8_t);
+	if (header->featuresNum > size / sizeof(SidecarFeature) ||
+		header->intervalsNum > size / intervalSize || header->stringsSize > size)
+	{
+		return false;
+	}
+	uint64_t expectedSize = sizeof(Header) + header->featuresNum * sizeof(SidecarFeature) +
+		header->intervalsNum * intervalSize + header->stringsSize;
+	if (expectedSize != size) { return false; }
+
+	features = (const SidecarFeature *)(data + sizeof(Header));
+	in = (const int64_t *)(features + header->featuresNum);
+	out = in + header->intervalsNum;
+	intensity = (const int8_t *)(out + header->intervalsNum);
+	strings = (const char *)(intensity + header->intervalsNum);
+
+	if (header->stringsSize == 0 || strings[header->stringsSize - 1] != '\0') { return false; }
+	for (size_t i = 0; i < header->featuresNum; i++)
+	{
+		const SidecarFeature &f = features[i];
+		if (f.name >= header->stringsSize || f.description >= header->stringsSize ||
+			f.action >= header->stringsSize || f.eq >= header->stringsSize)
+		{
+			return false;
+		}
+		if (f.firstInterval > header->intervalsNum ||
+			f.intervalsNum > header->intervalsNum - f.firstInterval)
+		{
+			return false;
+		}
+	}
+
+	return true; //columns are checked when read, so open does not touch them
+}
+
+bool FeatureSidecar::checkIntervals(const SidecarFeature &f) const
+{
+	//no branches per interval, so the loops are vectorized
+	const int64_t *fin = in + f.firstInterval;
+	const int64_t *fout = out + f.firstInterval;
+	bool ordered = true;
+	for (uint64_t i = 0; i < f.intervalsNum; i++) { ordered &= (fin[i] >= 0) & (fin[i] < fout[i]); }
+	for (uint64_t i = 1; i < f.intervalsNum; i++) { ordered &= (fin[i - 1] <= fin[i]); }
+	if (!ordered) { Log::err("Feature %s of sidecar has unordered intervals, ignored", getString(f.name)); }
+	return ordered;
+}
+
+size_t FeatureSidecar::getFeaturesNum() const
+{
+	return valid ? header->featuresNum : 0;
+}
+
+size_t FeatureSidecar::getIntervalsNum() const
+{
+	return valid ? header->intervalsNum : 0;
+}
+
+void FeatureSidecar::appendIntervals(const SidecarFeature &f, Feature &feature) const
+{
+	feature.appendIntervals(in + f.firstInterval, out + f.firstInterval,
+		intensity + f.firstInterval, f.intervalsNum);
+}
+
+void FeatureSidecar::mergeInto(FeatureList &list) const
+{
+	if (!valid) { return; }
+	for (size_t i = 0; i < header->featuresNum; i++)
+	{
+		const SidecarFeature &f = features[i];
+		if (!checkIntervals(f)) { continue; }
+		Feature *feature = list.find(getString(f.name));
+		if (!feature)
+		{
+			feature = new Feature(getString(f.name), getString(f.description),
+				getString(f.action), getString(f.eq), f.recIntensity);
+			list.push_back(feature);
+		}
+		appendIntervals(f, *feature);
+	}
+}
+
+void FeatureSidecar::mergeInto(Feature &feature) const
+{
+	if (!valid) { return; }
+	for (size_t i = 0; i < header->featuresNum; i++)
+	{
+		if (feature.getName() == getString(features[i].name) && checkIntervals(features[i]))
+		{
+			appendIntervals(features[i], feature);
+		}
+	}
+}
+
+uint64_t FeatureSidecar::Writer::addString(const std::string &str)
+{
+	auto it = stringIndex.find(str);
+	if (it != stringIndex.end()) { return it->second; }
+
+	uint64_t offset = strings.size();
+	strings.append(str.c_str(), str.size() + 1);
+	stringIndex.emplace(str, offset);
+	return offset;
+}
+
+void FeatureSidecar::Writer::addFeature(const Feature &feature)
+{
+	SidecarFeature f = {};
+	f.name = addString(feature.getName());
+	f.description = addString(feature.getDescription());
+	f.action = addString(feature.getAction());
+	f.eq = addString(feature.getEq());
+	f.recIntensity = feature.getRecIntensity();
+	f.firstInterval = in.size();
+	f.intervalsNum = feature.getIntervals().size();
+	features.push_back(f);
+
+	for (const Interval &interval: feature.getIntervals())
+	{
+		in.push_back(interval.in);
+		out.push_back(interval.out);
+		intensity.push_back(interval.intensity);
+	}
+}
+
+bool FeatureSidecar::Writer::write(const std::string &path) const
+{
+	Header header = {};
+	memcpy(header.magic, sidecarMagic, sizeof(sidecarMagic));
+	header.version = sidecarVersion;
+	header.frameRateNum = frameRate.num;
+	header.frameRateDen = frameRate.den;
+	header.featuresNum = features.size();
+	header.intervalsNum = in.size();
+	header.stringsSize = strings.empty() ? 1 : strings.size();
+
+	//write to temporary file first, so the project is never opened with partial sidecar
+	std::string tmpPath = path + ".tmp";
+	{
+		std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+		if (!file) { return false; }
+		file.write((const char *)&header, sizeof(header));
+		file.write((const char *)features.data(), features.size() * sizeof(SidecarFeature));
+		file.write((const char *)in.data(), in.size() * sizeof(int64_t));
+		file.write((const char *)out.data(), out.size() * sizeof(int64_t));
+		file.write((const char *)intensity.data(), intensity.size() * sizeof(int8_t));
+		if (strings.empty()) { file.put('\0'); }
+		else { file.write(strings.data(), strings.size()); }
+		if (!file) { file.close(); remove(tmpPath.c_str()); return false; }
+	}
+	if (rename(tmpPath.c_str(), path.c_str()) != 0)
+	{
+		remove(tmpPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+}
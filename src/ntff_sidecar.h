@@ -0,0 +1,94 @@
+#ifndef NTFF_SIDECAR_H
+#define NTFF_SIDECAR_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "ntff_feature.h"
+#include "ntff_timecode.h"
+
+namespace Ntff {
+
+class MappedFile;
+
+/* Features written by detectors (.ntff file next to the project), for tracks
+ * too big to go through kdenlive XML. Layout, little endian:
+ *   Header, SidecarFeature[featuresNum],
+ *   int64 in[intervalsNum], int64 out[intervalsNum], int8 intensity[intervalsNum],
+ *   strings (null-terminated, referenced by offset).
+ * Intervals of a feature are a contiguous range of the columns, sorted by in,
+ * in frames of the project frame rate. File is mapped and columns are read in bulk. */
+class FeatureSidecar
+{
+public:
+	class Writer;
+
+	FeatureSidecar(const std::string &projectFile, const FrameRate &frameRate);
+	~FeatureSidecar();
+	bool isValid() const { return valid; }
+	size_t getFeaturesNum() const;
+	size_t getIntervalsNum() const;
+	void mergeInto(FeatureList &features) const; //features with the same name get intervals added
+	void mergeInto(Feature &feature) const;
+
+	static std::string pathFor(const std::string &projectFile);
+private:
+	struct Header
+	{
+		char magic[4];
+		uint32_t version;
+		int32_t frameRateNum;
+		int32_t frameRateDen;
+		uint32_t featuresNum;
+		uint32_t reserved;
+		uint64_t intervalsNum;
+		uint64_t stringsSize;
+	};
+	struct SidecarFeature
+	{
+		uint64_t name;
+		uint64_t description;
+		uint64_t action;
+		uint64_t eq;
+		uint64_t firstInterval;
+		uint64_t intervalsNum;
+		int8_t recIntensity;
+		uint8_t reserved[7];
+	};
+
+	MappedFile *file;
+	bool valid;
+	const Header *header;
+	const SidecarFeature *features;
+	const int64_t *in;
+	const int64_t *out;
+	const int8_t *intensity;
+	const char *strings;
+
+	bool validate(const FrameRate &frameRate);
+	bool checkIntervals(const SidecarFeature &f) const;
+	const char *getString(uint64_t offset) const { return strings + offset; }
+	void appendIntervals(const SidecarFeature &f, Feature &feature) const;
+};
+
+class FeatureSidecar::Writer
+{
+public:
+	Writer(const FrameRate &frameRate): frameRate(frameRate) {}
+	void addFeature(const Feature &feature); //with its intervals
+	bool write(const std::string &path) const;
+private:
+	FrameRate frameRate;
+	std::vector<SidecarFeature> features;
+	std::vector<int64_t> in;
+	std::vector<int64_t> out;
+	std::vector<int8_t> intensity;
+	std::string strings;
+	std::unordered_map<std::string, uint64_t> stringIndex;
+
+	uint64_t addString(const std::string &str);
+};
+
+}
+
+#endif // NTFF_SIDECAR_H
@@ -0,0 +1,49 @@
+#include "ntff_stats.h"
+#include <cstdio>
+
+namespace Ntff {
+
+void LoadStats::clear()
+{
+	cacheTime = parseTime = bindTime = pathsTime = demuxTime = openTime = 0;
+	nodes = producers = playlists = entries = tracks = directories = pathLookups = demuxers = modelBytes = sidecarIntervals = 0;
+	fromCache = false;
+}
+
+void LoadStats::visit(const std::function<void(const char *, double)> &time, 
+	const std::function<void(const char *, size_t)> &counter) const
+{
+	time("open-time", openTime);
+	time("cache-time", cacheTime);
+	time("parse-time", parseTime);
+	time("bind-time", bindTime);
+	time("paths-time", pathsTime);
+	time("demux-time", demuxTime);
+	counter("from-cache", fromCache);
+	counter("nodes", nodes);
+	counter("producers", producers);
+	counter("playlists", playlists);
+	counter("entries", entries);
+	counter("tracks", tracks);
+	counter("directories", directories);
+	counter("path-lookups", pathLookups);
+	counter("demuxers", demuxers);
+	counter("model-bytes", modelBytes);
+	counter("sidecar-intervals", sidecarIntervals);
+}
+
+std::string LoadStats::toString() const
+{
+	std::string res;
+	char buffer[64];
+	auto append = [&res, &buffer] ()
+	{
+		if (!res.empty()) { res += ' '; }
+		res += buffer;
+	};
+	visit([&] (const char *name, double ms) { snprintf(buffer, sizeof(buffer), "%s=%.3f", name, ms); append(); }, 
+		[&] (const char *name, size_t value) { snprintf(buffer, sizeof(buffer), "%s=%zu", name, value); append(); });
+	return res;
+}
+
+}
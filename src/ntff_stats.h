@@ -0,0 +1,62 @@
+#ifndef NTFF_STATS_H
+#define NTFF_STATS_H
+
+#include <string>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+
+namespace Ntff {
+
+/* Durations (ms) and counters of project opening phases, 
+ * filled by Project and Player to see what makes open slow. */
+struct LoadStats
+{
+	LoadStats() { clear(); }
+	void clear();
+
+	double cacheTime;    //reading .ntffc cache
+	double parseTime;    //reading and parsing XML
+	double bindTime;     //binding entries to producers, tracks to playlists
+	double pathsTime;    //resolving media paths
+	double demuxTime;    //opening demuxers of media files
+	double openTime;     //whole open
+
+	size_t nodes;
+	size_t producers;
+	size_t playlists;
+	size_t entries;
+	size_t tracks;
+	size_t directories;  //directories listed to resolve paths
+	size_t pathLookups;
+	size_t demuxers;
+	size_t modelBytes;   //arena of parsed project model
+	size_t sidecarIntervals;
+	bool fromCache;
+
+	//every value with its name, as published on demux object: ntff-<name>
+	void visit(const std::function<void(const char *name, double ms)> &time, 
+		const std::function<void(const char *name, size_t value)> &counter) const;
+	std::string toString() const;
+};
+
+//adds time (monotonic) passed until next phase or destruction to the value of current phase
+class PhaseTimer
+{
+public:
+	PhaseTimer(double &target): target(&target), start(Clock::now()) {}
+	~PhaseTimer() { stop(); }
+	PhaseTimer(const PhaseTimer &) = delete;
+	PhaseTimer &operator=(const PhaseTimer &) = delete;
+	void next(double &nextTarget) { stop(); target = &nextTarget; start = Clock::now(); }
+private:
+	using Clock = std::chrono::steady_clock;
+	double *target;
+	Clock::time_point start;
+
+	void stop() { *target += std::chrono::duration<double, std::milli>(Clock::now() - start).count(); }
+};
+
+}
+
+#endif // NTFF_STATS_H
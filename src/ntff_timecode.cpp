@@ -0,0 +1,88 @@
+#include "ntff_timecode.h"
+#include <cmath>
+
+namespace Ntff {
+
+static const int64_t timeScale = 1000000; //microseconds, CLOCK_FREQ of VLC
+static const int maxFieldDigits = 6;
+static const uint64_t maxFractionScale = 1000000000; //digits after 9th are ignored
+
+static inline unsigned digit(char c) { return (unsigned char)c - (unsigned)'0'; }
+
+static inline bool readField(const char *&str, uint64_t &res)
+{
+	const char *begin = str;
+	res = 0;
+	for (unsigned d; (d = digit(*str)) < 10; str++) { res = res * 10 + d; }
+	return str != begin && str - begin <= maxFieldDigits;
+}
+
+int64_t FrameRate::framesToTime(frame_id frames) const
+{
+	if (!isValid()) { return 0; }
+	//split to keep products in 64 bits for any frame number
+	return frames / num * den * timeScale + frames % num * den * timeScale / num;
+}
+
+frame_id FrameRate::timeToFrames(int64_t time) const
+{
+	if (!isValid()) { return 0; }
+	int64_t div = den * timeScale;
+	return time / div * num + (time % div * num + div / 2) / div;
+}
+
+frame_id FrameRate::parseTime(const char *time) const
+{
+	if (!isValid() || !time) { return 0; }
+
+	const char *str = time;
+	uint64_t fields[3];
+	int fieldsNum = 0;
+	while (true)
+	{
+		if (fieldsNum == 3 || !readField(str, fields[fieldsNum])) { return 0; }
+		fieldsNum++;
+		if (*str != ':') { break; }
+		str++;
+	}
+	if (fieldsNum == 1) { return (*str == '\0') ? fields[0] : 0; }
+
+	uint64_t fraction = 0, scale = 1;
+	if (*str == '.')
+	{
+		for (unsigned d; (d = digit(*++str)) < 10;)
+		{
+			if (scale < maxFractionScale) { fraction = fraction * 10 + d; scale *= 10; }
+		}
+	}
+
+	uint64_t hours = (fieldsNum == 3) ? fields[0] : 0;
+	uint64_t minutes = fields[fieldsNum - 2];
+	uint64_t seconds = fields[fieldsNum - 1];
+	uint64_t n = num, d = den;
+	double fps = toDouble();
+
+	//terms of MLT time_clock_to_frames: floor(fps * h * 3600) + floor(fps * m * 60) + lrint(fps * s),
+	//evaluated exactly; all products stay below 2^63 with maxTerm and field limits.
+	//When exact term is whole (or half for lrint), double evaluation of MLT may land on either side,
+	//so these rare cases repeat its arithmetic to give the same frame
+	uint64_t hoursPart = hours * 3600 * n;
+	uint64_t res = hoursPart / d;
+	if (d > 1 && hoursPart % d == 0 && hours) { res = floor(fps * (int)hours * 3600); }
+
+	uint64_t minutesPart = minutes * 60 * n;
+	if (d > 1 && minutesPart % d == 0 && minutes) { res += floor(fps * (int)minutes * 60); }
+	else { res += minutesPart / d; }
+
+	uint64_t whole = seconds * n;
+	uint64_t div = d * scale;
+	uint64_t part = whole % d * scale + fraction * n;
+	uint64_t frames = whole / d + part / div;
+	uint64_t rem = part % div;
+	if (2 * rem == div) { frames = lrint(fps * ((double)(seconds * scale + fraction) / scale)); }
+	else { frames += (2 * rem > div); }
+
+	return res + frames;
+}
+
+}
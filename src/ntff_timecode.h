@@ -0,0 +1,32 @@
+#ifndef NTFF_TIMECODE_H
+#define NTFF_TIMECODE_H
+
+#include <cstdint>
+#include "ntff_feature.h"
+
+namespace Ntff {
+
+/* Frame rate kept as exact rational (frame_rate_num/frame_rate_den of MLT profile),
+ * so 29.97 or 59.94 fps timelines do not drift with project length. */
+struct FrameRate
+{
+	FrameRate(): num(0), den(1) {}
+	FrameRate(int32_t num, int32_t den): num(num), den(den) {}
+	bool isValid() const { return num > 0 && den > 0 && num <= maxTerm && den <= maxTerm; }
+	double toDouble() const { return isValid() ? (double)num / den : 0; }
+	int64_t framesToTime(frame_id frames) const; // microseconds, rounded down
+	frame_id timeToFrames(int64_t time) const; // nearest frame
+
+	// parse frame id from HH:MM:SS.fff clock value (or plain frame number) like MLT does,
+	// 0 for malformed value
+	frame_id parseTime(const char *time) const;
+
+	int32_t num;
+	int32_t den;
+
+	static const int32_t maxTerm = 1000000;
+};
+
+}
+
+#endif // NTFF_TIMECODE_H
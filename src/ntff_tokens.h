@@ -0,0 +1,147 @@
+#ifndef NTFF_TOKENS_H
+#define NTFF_TOKENS_H
+
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+
+namespace Ntff {
+
+/* Element, attribute and property names of kdenlive/MLT project the parser handles.
+ * Names are mapped to tokens with perfect hash table built at compile time,
+ * so parser compares integers instead of constructing strings for every node. */
+enum class Token : uint8_t
+{
+	Unknown,
+	Mlt,
+	Profile,
+	Producer,
+	Playlist,
+	Tractor,
+	Entry,
+	Blank,
+	Property,
+	Track,
+	Id,
+	Name,
+	In,
+	Out,
+	Length,
+	FrameRateNum,
+	FrameRateDen,
+	Resource,
+	KdenliveClipname,
+	KdenliveIntensity,
+	KdenliveTrackName,
+	KdenliveFeatureTrack,
+	KdenliveFeatureDescription,
+	KdenliveFeatureRecAction,
+	KdenliveFeatureRecEq,
+	KdenliveFeatureRecIntensity
+};
+
+namespace TokenTable {
+
+struct Item
+{
+	std::string_view name;
+	Token token;
+};
+
+constexpr Item items[] = {
+	{"mlt", Token::Mlt},
+	{"profile", Token::Profile},
+	{"producer", Token::Producer},
+	{"playlist", Token::Playlist},
+	{"tractor", Token::Tractor},
+	{"entry", Token::Entry},
+	{"blank", Token::Blank},
+	{"property", Token::Property},
+	{"track", Token::Track},
+	{"id", Token::Id},
+	{"name", Token::Name},
+	{"in", Token::In},
+	{"out", Token::Out},
+	{"length", Token::Length},
+	{"frame_rate_num", Token::FrameRateNum},
+	{"frame_rate_den", Token::FrameRateDen},
+	{"resource", Token::Resource},
+	{"kdenlive:clipname", Token::KdenliveClipname},
+	{"kdenlive:intensity", Token::KdenliveIntensity},
+	{"kdenlive:track_name", Token::KdenliveTrackName},
+	{"kdenlive:feature_track", Token::KdenliveFeatureTrack},
+	{"kdenlive:feature_description", Token::KdenliveFeatureDescription},
+	{"kdenlive:feature_rec_action", Token::KdenliveFeatureRecAction},
+	{"kdenlive:feature_rec_eq", Token::KdenliveFeatureRecEq},
+	{"kdenlive:feature_rec_intensity", Token::KdenliveFeatureRecIntensity},
+};
+constexpr size_t itemsNum = sizeof(items) / sizeof(items[0]);
+constexpr uint32_t size = 64; //power of two, every item needs own slot
+static_assert(itemsNum <= size, "Token table is too small");
+
+constexpr uint32_t hash(std::string_view str, uint32_t seed)
+{
+	uint32_t res = seed ^ (uint32_t)str.size();
+	for (char c: str)
+	{
+		res = (res ^ (uint8_t)c) * 16777619u;
+	}
+	return res ^ (res >> 15);
+}
+
+constexpr bool isPerfect(uint32_t seed)
+{
+	uint64_t used = 0;
+	for (const Item &item: items)
+	{
+		uint64_t slot = uint64_t(1) << (hash(item.name, seed) & (size - 1));
+		if (used & slot) { return false; }
+		used |= slot;
+	}
+	return true;
+}
+
+constexpr uint32_t findSeed()
+{
+	for (uint32_t seed = 0; seed < 100000; seed++)
+	{
+		if (isPerfect(seed)) { return seed; }
+	}
+	return UINT32_MAX;
+}
+
+constexpr uint32_t seed = findSeed();
+static_assert(seed != UINT32_MAX, "No perfect hash seed for token table");
+
+struct Slots
+{
+	uint8_t item[size]; //index in items + 1, 0 for empty slot
+};
+
+constexpr Slots buildSlots()
+{
+	Slots res = {};
+	for (size_t id = 0; id < itemsNum; id++)
+	{
+		res.item[hash(items[id].name, seed) & (size - 1)] = id + 1;
+	}
+	return res;
+}
+
+constexpr Slots slots = buildSlots();
+
+}
+
+constexpr Token tokenize(std::string_view str)
+{
+	uint8_t id = TokenTable::slots.item[TokenTable::hash(str, TokenTable::seed) & (TokenTable::size - 1)];
+	if (id == 0 || TokenTable::items[id - 1].name != str) { return Token::Unknown; }
+	return TokenTable::items[id - 1].token;
+}
+
+static_assert(tokenize("kdenlive:feature_rec_eq") == Token::KdenliveFeatureRecEq, "Token table is broken");
+static_assert(tokenize("producers") == Token::Unknown, "Token table is broken");
+
+}
+
+#endif // NTFF_TOKENS_H
@@ -0,0 +1,109 @@
+#include "ntff_watcher.h"
+#include "ntff_log.h"
+#include <filesystem>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+#include <climits>
+#include <cerrno>
+#endif
+
+namespace Ntff {
+
+static const int quietPeriod = 300; //ms without events before callback
+
+#ifdef __linux__
+
+FileWatcher::FileWatcher(const std::string &file, const Callback &callback):
+	callback(callback), notifyFd(-1), stopFd(-1), valid(false)
+{
+	std::filesystem::path path(file);
+	filename = path.filename();
+	std::string directory = path.parent_path().empty() ? "." : path.parent_path().string();
+
+	notifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (notifyFd < 0 || stopFd < 0 ||
+		inotify_add_watch(notifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0)
+	{
+		Log::warn("Unable to watch %s for changes", file.c_str());
+		return;
+	}
+
+	valid = true;
+	void *logData;
+	Log::Handler logHandler = Log::getHandler(logData);
+	thread = std::thread([this, logHandler, logData]()
+	{
+		Log::setHandler(logHandler, logData);
+		run();
+	});
+}
+
+FileWatcher::~FileWatcher()
+{
+	if (thread.joinable())
+	{
+		uint64_t value = 1;
+		if (write(stopFd, &value, sizeof(value)) < 0) { Log::err("Unable to stop file watcher"); }
+		thread.join();
+	}
+	if (notifyFd >= 0) { close(notifyFd); }
+	if (stopFd >= 0) { close(stopFd); }
+}
+
+bool FileWatcher::readEvents()
+{
+	bool res = false;
+	alignas(inotify_event) char buffer[sizeof(inotify_event) + NAME_MAX + 1];
+	ssize_t len;
+	while ((len = read(notifyFd, buffer, sizeof(buffer))) > 0)
+	{
+		for (char *pos = buffer; pos < buffer + len;)
+		{
+			const inotify_event *event = (const inotify_event *)pos;
+			if (event->len && filename == event->name) { res = true; }
+			pos += sizeof(inotify_event) + event->len;
+		}
+	}
+	return res;
+}
+
+void FileWatcher::run()
+{
+	pollfd fds[2] = {{notifyFd, POLLIN, 0}, {stopFd, POLLIN, 0}};
+	bool pending = false;
+	while (true)
+	{
+		int res = poll(fds, 2, pending ? quietPeriod : -1);
+		if (res < 0 && errno == EINTR) { continue; }
+		if (res < 0) { Log::err("Unable to wait for file changes"); return; }
+		if (fds[1].revents) { return; }
+
+		if (res == 0)
+		{
+			pending = false;
+			callback();
+		}
+		else if (fds[0].revents && readEvents()) { pending = true; }
+	}
+}
+
+#else
+
+FileWatcher::FileWatcher(const std::string &file, const Callback &callback):
+	callback(callback), notifyFd(-1), stopFd(-1), valid(false)
+{
+	Log::warn("Unable to watch %s for changes: not supported on this system", file.c_str());
+}
+
+FileWatcher::~FileWatcher() {}
+bool FileWatcher::readEvents() { return false; }
+void FileWatcher::run() {}
+
+#endif
+
+}
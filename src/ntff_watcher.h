@@ -0,0 +1,37 @@
+#ifndef NTFF_WATCHER_H
+#define NTFF_WATCHER_H
+
+#include <string>
+#include <functional>
+#include <thread>
+
+namespace Ntff {
+
+/* Calls back (from own thread) when the file is written or replaced.
+ * Parent directory is watched with inotify, as editors save through rename.
+ * Bursts of events are merged, callback comes once file is quiet for a while. */
+class FileWatcher
+{
+public:
+	typedef std::function<void()> Callback;
+
+	FileWatcher(const std::string &file, const Callback &callback);
+	~FileWatcher();
+	FileWatcher(const FileWatcher &) = delete;
+	FileWatcher &operator=(const FileWatcher &) = delete;
+	bool isValid() const { return valid; }
+private:
+	std::string filename;
+	Callback callback;
+	int notifyFd;
+	int stopFd;
+	bool valid;
+	std::thread thread;
+
+	void run();
+	bool readEvents();
+};
+
+}
+
+#endif // NTFF_WATCHER_H
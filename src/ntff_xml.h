@@ -0,0 +1,35 @@
+#ifndef NTFF_XML_H
+#define NTFF_XML_H
+
+#include <cstddef>
+
+namespace Ntff {
+
+/* Minimal pull XML reader interface the project parser is written against.
+ * Semantics follow VLC xml_reader_t: comments, processing instructions and
+ * whitespace-only text are skipped, returned strings stay valid until the next call. */
+class XmlReader
+{
+public:
+	enum NodeType
+	{
+		Error = -1,
+		None = 0,
+		StartElem = 1,
+		EndElem,
+		Text
+	};
+
+	XmlReader(): nodesNum(0) {}
+	virtual ~XmlReader() {}
+	virtual int nextNode(const char **value) = 0;
+	virtual const char *nextAttr(const char **value) = 0;
+	virtual bool isEmptyElement() = 0;
+	size_t getNodesNum() const { return nodesNum; } //returned by nextNode, for load statistics
+protected:
+	size_t nodesNum;
+};
+
+}
+
+#endif // NTFF_XML_H
@@ -0,0 +1,617 @@
+#include "ntff_xml_fast.h"
+#include "ntff_mmap.h"
+#include "ntff_log.h"
+#include <cstring>
+#include <cstdint>
+#include <strings.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define NTFF_X86_SIMD
+#endif
+
+namespace Ntff {
+
+static FastXmlReader::Simd detectSimd()
+{
+#ifdef NTFF_X86_SIMD
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) { return FastXmlReader::Avx2; }
+#ifdef __SSE2__
+	return FastXmlReader::Sse2;
+#endif
+#endif
+	return FastXmlReader::Scalar;
+}
+
+static const FastXmlReader::Simd bestSimd = detectSimd();
+static FastXmlReader::Simd simd = bestSimd;
+
+template<char... Chars> static inline bool isAny(char c) { return ((c == Chars) || ...); }
+
+template<char... Chars> static const char *findAnyScalar(const char *pos, const char *end)
+{
+	while (pos < end && !isAny<Chars...>(*pos)) { pos++; }
+	return pos;
+}
+
+#ifdef __SSE2__
+template<char... Chars> static const char *findAnySse2(const char *pos, const char *end)
+{
+	for (; end - pos >= 16; pos += 16)
+	{
+		__m128i block = _mm_loadu_si128((const __m128i *)pos);
+		__m128i match = _mm_setzero_si128();
+		((match = _mm_or_si128(match, _mm_cmpeq_epi8(block, _mm_set1_epi8(Chars)))), ...);
+		int mask = _mm_movemask_epi8(match);
+		if (mask) { return pos + __builtin_ctz(mask); }
+	}
+	return findAnyScalar<Chars...>(pos, end);
+}
+#endif
+
+#ifdef NTFF_X86_SIMD
+//compiled for AVX2 regardless of build flags, used only if CPU has it
+template<char... Chars> __attribute__((target("avx2")))
+static const char *findAnyAvx2(const char *pos, const char *end)
+{
+	for (; end - pos >= 32; pos += 32)
+	{
+		__m256i block = _mm256_loadu_si256((const __m256i *)pos);
+		__m256i match = _mm256_setzero_si256();
+		((match = _mm256_or_si256(match, _mm256_cmpeq_epi8(block, _mm256_set1_epi8(Chars)))), ...);
+		unsigned mask = _mm256_movemask_epi8(match);
+		if (mask) { return pos + __builtin_ctz(mask); }
+	}
+	return findAnyScalar<Chars...>(pos, end);
+}
+#endif
+
+//first of the characters in [pos, end), end if there is none
+template<char... Chars> static inline const char *findAny(const char *pos, const char *end)
+{
+	switch (simd)
+	{
+#ifdef NTFF_X86_SIMD
+		case FastXmlReader::Avx2: return findAnyAvx2<Chars...>(pos, end);
+#endif
+#ifdef __SSE2__
+		case FastXmlReader::Sse2: return findAnySse2<Chars...>(pos, end);
+#endif
+		default: return findAnyScalar<Chars...>(pos, end);
+	}
+}
+
+//control or non-ASCII character, except blanks
+static inline bool isSpecialByte(char c) { return (signed char)c < 0x20 && c != '\t' && c != '\n' && c != '\r'; }
+
+static const char *findSpecialByteScalar(const char *pos, const char *end)
+{
+	while (pos < end && !isSpecialByte(*pos)) { pos++; }
+	return pos;
+}
+
+#ifdef __SSE2__
+static const char *findSpecialByteSse2(const char *pos, const char *end)
+{
+	const __m128i space = _mm_set1_epi8(0x20);
+	for (; end - pos >= 16; pos += 16)
+	{
+		__m128i block = _mm_loadu_si128((const __m128i *)pos);
+		__m128i blank = _mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8('\n')),
+			_mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8('\t')), _mm_cmpeq_epi8(block, _mm_set1_epi8('\r'))));
+		//signed comparison, so non-ASCII bytes are below space as well
+		int mask = _mm_movemask_epi8(_mm_andnot_si128(blank, _mm_cmplt_epi8(block, space)));
+		if (mask) { return pos + __builtin_ctz(mask); }
+	}
+	return findSpecialByteScalar(pos, end);
+}
+#endif
+
+#ifdef NTFF_X86_SIMD
+__attribute__((target("avx2")))
+static const char *findSpecialByteAvx2(const char *pos, const char *end)
+{
+	const __m256i space = _mm256_set1_epi8(0x20);
+	for (; end - pos >= 32; pos += 32)
+	{
+		__m256i block = _mm256_loadu_si256((const __m256i *)pos);
+		__m256i blank = _mm256_or_si256(_mm256_cmpeq_epi8(block, _mm256_set1_epi8('\n')),
+			_mm256_or_si256(_mm256_cmpeq_epi8(block, _mm256_set1_epi8('\t')), _mm256_cmpeq_epi8(block, _mm256_set1_epi8('\r'))));
+		unsigned mask = _mm256_movemask_epi8(_mm256_andnot_si256(blank, _mm256_cmpgt_epi8(space, block)));
+		if (mask) { return pos + __builtin_ctz(mask); }
+	}
+	return findSpecialByteScalar(pos, end);
+}
+#endif
+
+static inline const char *findSpecialByte(const char *pos, const char *end)
+{
+	switch (simd)
+	{
+#ifdef NTFF_X86_SIMD
+		case FastXmlReader::Avx2: return findSpecialByteAvx2(pos, end);
+#endif
+#ifdef __SSE2__
+		case FastXmlReader::Sse2: return findSpecialByteSse2(pos, end);
+#endif
+		default: return findSpecialByteScalar(pos, end);
+	}
+}
+
+//length of valid utf-8 sequence of XML character at pos, 0 if it is invalid
+static size_t utf8Length(const char *pos, const char *end)
+{
+	const unsigned char *s = (const unsigned char *)pos;
+	size_t available = end - pos;
+	auto cont = [s] (size_t i, unsigned char min = 0x80, unsigned char max = 0xBF) { return s[i] >= min && s[i] <= max; };
+	if (s[0] >= 0xC2 && s[0] <= 0xDF) { return (available >= 2 && cont(1)) ? 2 : 0; }
+	if (s[0] >= 0xE0 && s[0] <= 0xEF)
+	{
+		if (available < 3) { return 0; }
+		unsigned char min = (s[0] == 0xE0) ? 0xA0 : 0x80;
+		unsigned char max = (s[0] == 0xED) ? 0x9F : 0xBF;
+		if (!cont(1, min, max) || !cont(2)) { return 0; }
+		if (s[0] == 0xEF && s[1] == 0xBF && s[2] >= 0xBE) { return 0; } //U+FFFE, U+FFFF
+		return 3;
+	}
+	if (s[0] >= 0xF0 && s[0] <= 0xF4)
+	{
+		if (available < 4) { return 0; }
+		unsigned char min = (s[0] == 0xF0) ? 0x90 : 0x80;
+		unsigned char max = (s[0] == 0xF4) ? 0x8F : 0xBF;
+		return (cont(1, min, max) && cont(2) && cont(3)) ? 4 : 0;
+	}
+	return 0;
+}
+
+//only blanks of control characters are allowed, the rest has to be valid utf-8
+static bool isValidText(const char *pos, const char *end)
+{
+	while ((pos = findSpecialByte(pos, end)) < end)
+	{
+		size_t len = utf8Length(pos, end);
+		if (!len) { return false; }
+		pos += len;
+	}
+	return true;
+}
+
+static inline bool isBlank(char c) { return c == ' ' || c == '\n' || c == '\t' || c == '\r'; }
+
+static inline const char *skipBlank(const char *pos, const char *end)
+{
+	while (pos < end && isBlank(*pos)) { pos++; }
+	return pos;
+}
+
+static inline bool startsWith(const char *pos, const char *end, const char *prefix)
+{
+	size_t len = strlen(prefix);
+	return (size_t)(end - pos) >= len && memcmp(pos, prefix, len) == 0;
+}
+
+//non-ASCII characters are not checked, they are rare in names
+static inline bool isNameStart(unsigned char c) { return ((c | 0x20) >= 'a' && (c | 0x20) <= 'z') || c == '_' || c >= 0x80; }
+static inline bool isNameChar(unsigned char c) { return isNameStart(c) || (c >= '0' && c <= '9') || c == '-' || c == '.'; }
+
+//returns end of the name at pos, nullptr if there is no name there;
+//names with namespace prefix (':') are left to generic reader as well
+static const char *scanName(const char *pos, const char *end)
+{
+	if (pos == end || !isNameStart(*pos)) { return nullptr; }
+	while (pos < end && isNameChar(*pos)) { pos++; }
+	return pos;
+}
+
+//name="value" or name='value' at pos, returns position after it
+static const char *scanPseudoAttr(const char *pos, const char *end, std::string &name, std::string &value)
+{
+	const char *nameEnd = scanName(pos, end);
+	if (!nameEnd) { return nullptr; }
+	name.assign(pos, nameEnd);
+	pos = skipBlank(nameEnd, end);
+	if (pos == end || *pos != '=') { return nullptr; }
+	pos = skipBlank(pos + 1, end);
+	if (pos == end || (*pos != '"' && *pos != '\'')) { return nullptr; }
+	const char *valueEnd = (const char *)memchr(pos + 1, *pos, end - pos - 1);
+	if (!valueEnd) { return nullptr; }
+	value.assign(pos + 1, valueEnd);
+	return valueEnd + 1;
+}
+
+static void appendUtf8(uint32_t code, std::string &res)
+{
+	if (code < 0x80) { res += (char)code; }
+	else if (code < 0x800)
+	{
+		res += (char)(0xC0 | (code >> 6));
+		res += (char)(0x80 | (code & 0x3F));
+	}
+	else if (code < 0x10000)
+	{
+		res += (char)(0xE0 | (code >> 12));
+		res += (char)(0x80 | ((code >> 6) & 0x3F));
+		res += (char)(0x80 | (code & 0x3F));
+	}
+	else
+	{
+		res += (char)(0xF0 | (code >> 18));
+		res += (char)(0x80 | ((code >> 12) & 0x3F));
+		res += (char)(0x80 | ((code >> 6) & 0x3F));
+		res += (char)(0x80 | (code & 0x3F));
+	}
+}
+
+//entity between '&' and ';', only predefined and character references are known without DTD
+static bool appendEntity(const char *begin, const char *end, std::string &res)
+{
+	size_t len = end - begin;
+	if (len >= 2 && *begin == '#')
+	{
+		const char *pos = begin + 1;
+		bool hex = (*pos == 'x');
+		if (hex) { pos++; }
+		if (pos == end) { return false; }
+
+		uint32_t code = 0;
+		for (; pos < end; pos++)
+		{
+			char c = *pos;
+			int digit = (c >= '0' && c <= '9') ? c - '0' :
+				(hex && c >= 'a' && c <= 'f') ? c - 'a' + 10 :
+				(hex && c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+			if (digit < 0) { return false; }
+			code = code * (hex ? 16 : 10) + digit;
+			if (code > 0x10FFFF) { return false; }
+		}
+		if ((code < 0x20 && code != '\t' && code != '\n' && code != '\r') ||
+			(code >= 0xD800 && code <= 0xDFFF) || code == 0xFFFE || code == 0xFFFF)
+		{
+			return false;
+		}
+		appendUtf8(code, res);
+		return true;
+	}
+
+	static const struct { const char *name; char value; } predefined[] =
+	{
+		{"lt", '<'}, {"gt", '>'}, {"amp", '&'}, {"quot", '"'}, {"apos", '\''}
+	};
+	for (const auto &entity: predefined)
+	{
+		if (len == strlen(entity.name) && memcmp(begin, entity.name, len) == 0)
+		{
+			res += entity.value;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool FastXmlReader::Range::operator==(const Range &other) const
+{
+	return end - begin == other.end - other.begin && memcmp(begin, other.begin, end - begin) == 0;
+}
+
+FastXmlReader::FastXmlReader(const char *data, size_t size, const Fallback &fallback):
+	file(nullptr), data(data), pos(data), end(data + size), fallback(fallback), fallbackReader(nullptr),
+	checked(false), rootClosed(false), emptyElement(false), nextAttribute(0)
+{
+	if (size >= 3 && memcmp(data, "\xEF\xBB\xBF", 3) == 0) //utf-8 BOM
+	{
+		this->data += 3;
+		pos = this->data;
+	}
+}
+
+FastXmlReader::~FastXmlReader()
+{
+	delete fallbackReader;
+	delete file;
+}
+
+int FastXmlReader::nextNode(const char **value)
+{
+	int type;
+	if (fallbackReader) { type = fallbackReader->nextNode(value); }
+	else if (!checked)
+	{
+		checked = true;
+		if (!isValidText(pos, end)) { return switchToFallback(value); }
+		return nextNode(value);
+	}
+	else
+	{
+		type = scanNode();
+		if (type == Unsupported) { return switchToFallback(value); }
+		if (type > None && value) { *value = node.c_str(); }
+	}
+	if (type > None) { nodesNum++; }
+	return type;
+}
+
+const char *FastXmlReader::nextAttr(const char **value)
+{
+	if (fallbackReader) { return fallbackReader->nextAttr(value); }
+	if (nextAttribute >= attributes.size()) { return nullptr; }
+
+	const Attribute &attr = attributes[nextAttribute++];
+	attrName.assign(attr.name.begin, attr.name.end);
+	if (attr.plain) { attrValue.assign(attr.value.begin, attr.value.end); }
+	else { decode(attr.value, true, attrValue); } //checked by scanStartTag
+	*value = attrValue.c_str();
+	return attrName.c_str();
+}
+
+bool FastXmlReader::isEmptyElement()
+{
+	if (fallbackReader) { return fallbackReader->isEmptyElement(); }
+	return emptyElement;
+}
+
+int FastXmlReader::scanNode()
+{
+	emptyElement = false;
+	attributes.clear();
+	nextAttribute = 0;
+
+	while (true)
+	{
+		const char *start = pos;
+		if (openElements.empty()) //prolog or epilog, only markup and blanks
+		{
+			pos = skipBlank(pos, end);
+			if (pos == end) { return rootClosed ? None : Unsupported; }
+			if (*pos != '<') { return Unsupported; }
+		}
+		else
+		{
+			pos = findAny<'<'>(pos, end);
+			if (pos == end) { return Unsupported; }
+			if (pos != start)
+			{
+				int type = scanText(start);
+				if (type != None) { return type; }
+			}
+		}
+
+		if (startsWith(pos, end, "<!--"))
+		{
+			const char *close = (const char *)memmem(pos + 4, end - pos - 4, "-->", 3);
+			if (!close) { return Unsupported; }
+			pos = close + 3;
+		}
+		else if (startsWith(pos, end, "<?"))
+		{
+			const char *targetEnd = scanName(pos + 2, end);
+			if (!targetEnd || targetEnd == end || (!isBlank(*targetEnd) && !startsWith(targetEnd, end, "?>")))
+			{
+				return Unsupported;
+			}
+			if (targetEnd - pos == 5 && strncasecmp(pos + 2, "xml", 3) == 0)
+			{
+				if (pos != data || memcmp(pos + 2, "xml", 3) != 0 || !skipDeclaration()) { return Unsupported; }
+				continue;
+			}
+			const char *close = (const char *)memmem(targetEnd, end - targetEnd, "?>", 2);
+			if (!close) { return Unsupported; }
+			pos = close + 2;
+		}
+		else if (startsWith(pos, end, "<!")) { return Unsupported; } //doctype, cdata
+		else if (startsWith(pos, end, "</")) { return scanEndTag(); }
+		else if (rootClosed) { return Unsupported; }
+		else { return scanStartTag(); }
+	}
+}
+
+int FastXmlReader::scanText(const char *textBegin)
+{
+	Range text = {textBegin, pos};
+	if (skipBlank(text.begin, text.end) == text.end) { return None; }
+	if (findAny<'&', '\r', ']', '\0'>(text.begin, text.end) == text.end)
+	{
+		node.assign(text.begin, text.end);
+		return Text;
+	}
+	if (!decode(text, false, node)) { return Unsupported; }
+	//character references may make it blank, generic reader skips it then
+	for (char c: node)
+	{
+		if (!isBlank(c)) { return Text; }
+	}
+	return None;
+}
+
+int FastXmlReader::scanStartTag()
+{
+	const char *nameEnd = scanName(pos + 1, end);
+	if (!nameEnd) { return Unsupported; }
+	Range name = {pos + 1, nameEnd};
+
+	const char *cur = nameEnd;
+	while (true)
+	{
+		const char *attrBegin = skipBlank(cur, end);
+		if (attrBegin == end) { return Unsupported; }
+		if (*attrBegin == '>') { cur = attrBegin + 1; break; }
+		if (*attrBegin == '/')
+		{
+			if (attrBegin + 1 == end || attrBegin[1] != '>') { return Unsupported; }
+			emptyElement = true;
+			cur = attrBegin + 2;
+			break;
+		}
+		if (attrBegin == cur) { return Unsupported; } //attributes are separated by blanks
+
+		Attribute attr;
+		const char *attrNameEnd = scanName(attrBegin, end);
+		if (!attrNameEnd || startsWith(attrBegin, attrNameEnd, "xmlns")) { return Unsupported; }
+		attr.name = Range{attrBegin, attrNameEnd};
+
+		cur = skipBlank(attrNameEnd, end);
+		if (cur == end || *cur != '=') { return Unsupported; }
+		cur = skipBlank(cur + 1, end);
+		if (cur == end || (*cur != '"' && *cur != '\'')) { return Unsupported; }
+		char quote = *cur++;
+
+		attr.value.begin = cur;
+		attr.plain = true;
+		while (true)
+		{
+			cur = (quote == '"') ? findAny<'"', '<', '&', '\t', '\n', '\r', '\0'>(cur, end) :
+				findAny<'\'', '<', '&', '\t', '\n', '\r', '\0'>(cur, end);
+			if (cur == end || *cur == '<' || *cur == '\0') { return Unsupported; }
+			if (*cur == quote) { break; }
+			attr.plain = false;
+			cur++;
+		}
+		attr.value.end = cur++;
+
+		if (!attr.plain && !decode(attr.value, true, attrValue)) { return Unsupported; }
+		for (const Attribute &other: attributes)
+		{
+			if (other.name == attr.name) { return Unsupported; }
+		}
+		attributes.push_back(attr);
+	}
+
+	node.assign(name.begin, name.end);
+	if (!emptyElement) { openElements.push_back(name); }
+	else if (openElements.empty()) { rootClosed = true; }
+	pos = cur;
+	return StartElem;
+}
+
+int FastXmlReader::scanEndTag()
+{
+	const char *nameEnd = scanName(pos + 2, end);
+	if (!nameEnd || openElements.empty()) { return Unsupported; }
+	Range name = {pos + 2, nameEnd};
+	const char *close = skipBlank(nameEnd, end);
+	if (close == end || *close != '>' || !(name == openElements.back())) { return Unsupported; }
+
+	openElements.pop_back();
+	rootClosed = openElements.empty();
+	node.assign(name.begin, name.end);
+	pos = close + 1;
+	return EndElem;
+}
+
+bool FastXmlReader::skipDeclaration()
+{
+	//<?xml version="1.x" [encoding="..."] [standalone="yes|no"]?>
+	const char *close = (const char *)memmem(pos, end - pos, "?>", 2);
+	if (!close) { return false; }
+
+	static const char *const fields[] = {"version", "encoding", "standalone"};
+	int lastField = -1;
+	std::string name, value;
+	const char *cur = pos + 5;
+	while (true)
+	{
+		const char *fieldBegin = skipBlank(cur, close);
+		if (fieldBegin == close) { break; }
+		if (fieldBegin == cur) { return false; }
+		cur = scanPseudoAttr(fieldBegin, close, name, value);
+		if (!cur) { return false; }
+
+		int field = lastField + 1;
+		while (field < 3 && name != fields[field]) { field++; }
+		if (field == 3 || (lastField == -1 && field != 0)) { return false; }
+		lastField = field;
+
+		//other encodings are converted by generic reader
+		if (field == 0 && (value.size() < 3 || value.compare(0, 2, "1.") != 0 ||
+			value.find_first_not_of("0123456789", 2) != std::string::npos)) { return false; }
+		if (field == 1 && strcasecmp(value.c_str(), "utf-8") != 0 && strcasecmp(value.c_str(), "utf8") != 0) { return false; }
+		if (field == 2 && value != "yes" && value != "no") { return false; }
+	}
+	if (lastField == -1) { return false; }
+	pos = close + 2;
+	return true;
+}
+
+bool FastXmlReader::decode(const Range &range, bool attribute, std::string &res)
+{
+	res.clear();
+	for (const char *cur = range.begin; cur < range.end; cur++)
+	{
+		char c = *cur;
+		if (c == '\0') { return false; }
+		if (c == '\r') //line ends are normalized to \n, blanks of attributes then to spaces
+		{
+			if (cur + 1 < range.end && cur[1] == '\n') { continue; }
+			c = '\n';
+		}
+		if (attribute && (c == '\n' || c == '\t')) { c = ' '; }
+		else if (!attribute && c == ']' && startsWith(cur, range.end, "]]>")) { return false; }
+		else if (c == '&')
+		{
+			const char *semicolon = (const char *)memchr(cur + 1, ';', range.end - cur - 1);
+			if (!semicolon || !appendEntity(cur + 1, semicolon, res)) { return false; }
+			cur = semicolon;
+			continue;
+		}
+		res += c;
+	}
+	return true;
+}
+
+int FastXmlReader::switchToFallback(const char **value)
+{
+	fallbackReader = fallback ? fallback() : nullptr;
+	if (!fallbackReader) { return Error; }
+	Log::dbg("Project is out of fast XML reader subset at offset %zu, using generic reader",
+		(size_t)(pos - data));
+
+	//generic reader returns the same nodes up to here
+	const char *skipped;
+	for (size_t i = 0; i < nodesNum; i++)
+	{
+		if (fallbackReader->nextNode(&skipped) <= None) { return Error; }
+	}
+	int type = fallbackReader->nextNode(value);
+	if (type > None) { nodesNum++; }
+	return type;
+}
+
+XmlReader *FastXmlReader::create(const std::string &file, const Fallback &fallback)
+{
+	MappedFile *mapped = new MappedFile(file);
+	if (!mapped->isValid())
+	{
+		delete mapped;
+		return fallback ? fallback() : nullptr;
+	}
+	FastXmlReader *res = new FastXmlReader((const char *)mapped->getData(), mapped->getSize(), fallback);
+	res->file = mapped;
+	return res;
+}
+
+XmlReader *FastXmlReader::create(const char *data, size_t size, const Fallback &fallback)
+{
+	return new FastXmlReader(data, size, fallback);
+}
+
+FastXmlReader::Simd FastXmlReader::getBestSimd() { return bestSimd; }
+FastXmlReader::Simd FastXmlReader::getSimd() { return simd; }
+
+bool FastXmlReader::setSimd(Simd value)
+{
+	if (value > bestSimd) { return false; }
+	simd = value;
+	return true;
+}
+
+const char *FastXmlReader::simdName(Simd value)
+{
+	switch (value)
+	{
+		case Avx2: return "avx2";
+		case Sse2: return "sse2";
+		default: return "scalar";
+	}
+}
+
+}
@@ -0,0 +1,79 @@
+#ifndef NTFF_XML_FAST_H
+#define NTFF_XML_FAST_H
+
+#include <string>
+#include <vector>
+#include <functional>
+#include "ntff_xml.h"
+
+namespace Ntff {
+
+class MappedFile;
+
+/* Tokenizer for the XML subset kdenlive writes: utf-8, no DTD, no CDATA,
+ * predefined and numeric entities only. Reads memory (mapped project) directly
+ * and looks for markup with SIMD, values are copied only when requested.
+ * On anything outside of the subset (or malformed) fallback reader is created
+ * and advanced to the same node, so results are always the ones of generic reader. */
+class FastXmlReader: public XmlReader
+{
+public:
+	typedef std::function<XmlReader *()> Fallback;
+	enum Simd { Scalar, Sse2, Avx2 };
+
+	FastXmlReader(const char *data, size_t size, const Fallback &fallback);
+	~FastXmlReader() override;
+	int nextNode(const char **value) override;
+	const char *nextAttr(const char **value) override;
+	bool isEmptyElement() override;
+	bool usesFallback() const { return fallbackReader != nullptr; }
+
+	static XmlReader *create(const std::string &file, const Fallback &fallback);
+	static XmlReader *create(const char *data, size_t size, const Fallback &fallback);
+	static Simd getBestSimd();
+	static Simd getSimd();
+	static bool setSimd(Simd value); //false if not supported by CPU
+	static const char *simdName(Simd value);
+private:
+	struct Range
+	{
+		const char *begin;
+		const char *end;
+		bool operator==(const Range &other) const;
+	};
+	struct Attribute
+	{
+		Range name;
+		Range value;
+		bool plain; //no entities or whitespace to normalize, copied as is
+	};
+	static const int Unsupported = -2; //scanned node is out of the subset
+
+	MappedFile *file;
+	const char *data;
+	const char *pos;
+	const char *end;
+	Fallback fallback;
+	XmlReader *fallbackReader;
+	bool checked; //characters are checked at once before first node
+	bool rootClosed;
+	bool emptyElement;
+	std::vector<Range> openElements;
+	std::vector<Attribute> attributes;
+	size_t nextAttribute;
+	std::string node;
+	std::string attrName;
+	std::string attrValue;
+
+	int scanNode();
+	int scanText(const char *textEnd);
+	int scanStartTag();
+	int scanEndTag();
+	bool skipDeclaration();
+	int switchToFallback(const char **value);
+	static bool decode(const Range &range, bool attribute, std::string &res);
+};
+
+}
+
+#endif // NTFF_XML_FAST_H
@@ -0,0 +1,103 @@
+#include "ntff_xml_libxml.h"
+#include <libxml/xmlreader.h>
+
+namespace Ntff {
+
+LibXmlReader::LibXmlReader(const std::string &file)
+{
+	reader = xmlReaderForFile(file.c_str(), nullptr, 0);
+}
+
+LibXmlReader::LibXmlReader(const char *data, size_t size)
+{
+	reader = xmlReaderForMemory(data, size, nullptr, nullptr, 0);
+}
+
+LibXmlReader::~LibXmlReader()
+{
+	if (reader) { xmlFreeTextReader(reader); }
+}
+
+int LibXmlReader::nextNode(const char **value)
+{
+	const xmlChar *res;
+	int type;
+	
+	while (true)
+	{
+		switch (xmlTextReaderRead(reader))
+		{
+			case 0: return None;
+			case -1: return Error;
+		}
+		
+		switch (xmlTextReaderNodeType(reader))
+		{
+			case XML_READER_TYPE_ELEMENT:
+				res = xmlTextReaderConstName(reader);
+				type = StartElem;
+				break;
+			case XML_READER_TYPE_END_ELEMENT:
+				res = xmlTextReaderConstName(reader);
+				type = EndElem;
+				break;
+			case XML_READER_TYPE_CDATA:
+			case XML_READER_TYPE_TEXT:
+				res = xmlTextReaderConstValue(reader);
+				type = Text;
+				break;
+			default:
+				continue;
+		}
+		break;
+	}
+	
+	if (!res) { return Error; }
+	nodesNum++;
+	node = (const char *)res;
+	if (value) { *value = node.c_str(); }
+	return type;
+}
+
+const char *LibXmlReader::nextAttr(const char **value)
+{
+	const xmlChar *name, *attrValue;
+	if (xmlTextReaderMoveToNextAttribute(reader) != 1 || 
+		(name = xmlTextReaderConstName(reader)) == nullptr ||
+		(attrValue = xmlTextReaderConstValue(reader)) == nullptr)
+	{
+		return nullptr;
+	}
+	
+	*value = (const char *)attrValue;
+	return (const char *)name;
+}
+
+bool LibXmlReader::isEmptyElement()
+{
+	return xmlTextReaderIsEmptyElement(reader) == 1;
+}
+
+XmlReader *LibXmlReader::create(const std::string &file)
+{
+	LibXmlReader *res = new LibXmlReader(file);
+	if (!res->isValid())
+	{
+		delete res;
+		return nullptr;
+	}
+	return res;
+}
+
+XmlReader *LibXmlReader::create(const char *data, size_t size)
+{
+	LibXmlReader *res = new LibXmlReader(data, size);
+	if (!res->isValid())
+	{
+		delete res;
+		return nullptr;
+	}
+	return res;
+}
+
+}
@@ -0,0 +1,33 @@
+#ifndef NTFF_XML_LIBXML_H
+#define NTFF_XML_LIBXML_H
+
+#include <string>
+#include "ntff_xml.h"
+
+typedef struct _xmlTextReader *xmlTextReaderPtr;
+
+namespace Ntff {
+
+/* libxml2 text reader behaving like VLC xml_reader_t (modules/misc/xml/libxml.c),
+ * used where project is loaded without VLC runtime. */
+class LibXmlReader: public XmlReader
+{
+public:
+	LibXmlReader(const std::string &file);
+	LibXmlReader(const char *data, size_t size);
+	~LibXmlReader() override;
+	bool isValid() const { return reader != nullptr; }
+	int nextNode(const char **value) override;
+	const char *nextAttr(const char **value) override;
+	bool isEmptyElement() override;
+
+	static XmlReader *create(const std::string &file);
+	static XmlReader *create(const char *data, size_t size);
+private:
+	xmlTextReaderPtr reader;
+	std::string node;
+};
+
+}
+
+#endif // NTFF_XML_LIBXML_H
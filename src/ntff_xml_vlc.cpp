@@ -0,0 +1,60 @@
+#include "ntff_xml_vlc.h"
+#include <vlc_xml.h>
+#include <vlc_stream.h>
+
+namespace Ntff {
+
+VlcXmlReader::VlcXmlReader(vlc_object_t *obj, stream_t *stream, bool ownStream):
+	stream(ownStream ? stream : nullptr)
+{
+	reader = xml_ReaderCreate(obj, stream);
+}
+
+VlcXmlReader::~VlcXmlReader()
+{
+	if (reader) { xml_ReaderDelete(reader); }
+	if (stream) { vlc_stream_Delete(stream); }
+}
+
+int VlcXmlReader::nextNode(const char **value)
+{
+	nodesNum++;
+	return xml_ReaderNextNode(reader, value);
+}
+
+const char *VlcXmlReader::nextAttr(const char **value)
+{
+	return xml_ReaderNextAttr(reader, value);
+}
+
+bool VlcXmlReader::isEmptyElement()
+{
+	return xml_ReaderIsEmptyElement(reader);
+}
+
+XmlReader *VlcXmlReader::create(vlc_object_t *obj, stream_t *stream)
+{
+	VlcXmlReader *res = new VlcXmlReader(obj, stream);
+	if (!res->isValid())
+	{
+		delete res;
+		return nullptr;
+	}
+	return res;
+}
+
+XmlReader *VlcXmlReader::create(vlc_object_t *obj, const char *data, size_t size)
+{
+	stream_t *stream = vlc_stream_MemoryNew(obj, (uint8_t *)data, size, true);
+	if (!stream) { return nullptr; }
+	
+	VlcXmlReader *res = new VlcXmlReader(obj, stream, true);
+	if (!res->isValid())
+	{
+		delete res;
+		return nullptr;
+	}
+	return res;
+}
+
+}
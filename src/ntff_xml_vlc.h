@@ -0,0 +1,29 @@
+#ifndef NTFF_XML_VLC_H
+#define NTFF_XML_VLC_H
+
+#include "ntff_xml.h"
+#include <vlc_common.h>
+
+namespace Ntff {
+
+class VlcXmlReader: public XmlReader
+{
+public:
+	VlcXmlReader(vlc_object_t *obj, stream_t *stream, bool ownStream = false);
+	~VlcXmlReader() override;
+	bool isValid() const { return reader != nullptr; }
+	int nextNode(const char **value) override;
+	const char *nextAttr(const char **value) override;
+	bool isEmptyElement() override;
+
+	static XmlReader *create(vlc_object_t *obj, stream_t *stream);
+	static XmlReader *create(vlc_object_t *obj, const char *data, size_t size);
+private:
+	xml_reader_t *reader;
+	stream_t *stream; //owned one, memory stream of data
+
+};
+
+}
+
+#endif // NTFF_XML_VLC_H